@@ -0,0 +1,112 @@
+// Compares MpmcQueue with the mutex queue and counting semaphores it replaced, both bounded to the same capacity,
+// handing integers from producer threads to consumer threads that block when there is nothing to do.
+// Usage: queue-benchmark [items per run] [capacity]
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+#include "MpmcQueue.hpp"
+
+// the queue used before MpmcQueue: std::queue under a mutex, consumers wait on a semaphore counting the elements
+// and producers on one counting the free slots, so both queues block at the same fill levels
+template <typename T>
+class MutexQueue {
+	std::queue<T> q;
+	std::mutex m;
+	std::counting_semaphore<> available{0};
+	std::counting_semaphore<> free;
+
+public:
+	explicit MutexQueue(ptrdiff_t capacity) : free(capacity) {}
+
+	void push(T v) {
+		free.acquire();
+		{
+			std::lock_guard<std::mutex> lock(m);
+			q.push(std::move(v));
+		}
+		available.release();
+	}
+
+	T pop() {
+		available.acquire();
+		T v;
+		{
+			std::lock_guard<std::mutex> lock(m);
+			v = std::move(q.front());
+			q.pop();
+		}
+		free.release();
+		return v;
+	}
+};
+
+// seconds to pass items from producers to consumers, the consumers stop on a -1 each
+template <typename Push, typename Pop>
+static double run(int producers, int consumers, long items, const Push &push, const Pop &pop) {
+	std::atomic<long> sum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	{
+		std::vector<std::jthread> threads;
+		for (int c = 0; c < consumers; c++) {
+			threads.emplace_back([&]() {
+				long local = 0;
+				for (long v = pop(); v >= 0; v = pop()) local += v;
+				sum += local;
+			});
+		}
+		std::vector<std::jthread> producer_threads;
+		for (int p = 0; p < producers; p++) {
+			producer_threads.emplace_back([&, p]() {
+				for (long i = p; i < items; i += producers) push(i);
+			});
+		}
+		producer_threads.clear(); // joins
+		for (int c = 0; c < consumers; c++) push(-1);
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (sum != items * (items - 1) / 2) std::fprintf(stderr, "Error: Items were lost or duplicated.\n");
+	return seconds;
+}
+
+// median of a few runs, the first threads of a process start slower
+template <typename Run>
+static double median_seconds(const Run &run_once) {
+	std::vector<double> seconds;
+	for (int i = 0; i < 5; i++) seconds.push_back(run_once());
+	std::sort(seconds.begin(), seconds.end());
+	return seconds[seconds.size() / 2];
+}
+
+int main(int argc, char *argv[]) {
+	const long items = argc > 1 ? std::atol(argv[1]) : 1000000;
+	const long capacity = argc > 2 ? std::max(1l, std::atol(argv[2])) : 64; // of the generator queues
+	const int cores = std::max(1u, std::thread::hardware_concurrency());
+
+	// one producer and one consumer per thread count up to the cores, more would measure oversubscription
+	std::printf("%ld items, capacity %ld, %d cores\n", items, capacity, cores);
+	std::printf("%-20s %16s %16s\n", "producers/consumers", "mutex Mitems/s", "mpmc Mitems/s");
+	for (int threads = 1; 2 * threads <= std::max(2, cores); threads *= 2) {
+		const double mutex_seconds = median_seconds([&]() {
+			MutexQueue<long> queue(capacity);
+			return run(threads, threads, items, [&](long v) { queue.push(v); }, [&]() { return queue.pop(); });
+		});
+		const double mpmc_seconds = median_seconds([&]() {
+			MpmcQueue<long> queue(capacity); // rounded up to a power of two
+			return run(threads, threads, items, [&](long v) { queue.push(v); }, [&]() { return *queue.pop(); });
+		});
+		std::printf("%9d/%-10d %16.2f %16.2f\n", threads, threads, items * 1e-6 / mutex_seconds, items * 1e-6 / mpmc_seconds);
+	}
+	return 0;
+}
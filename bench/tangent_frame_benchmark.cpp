@@ -0,0 +1,61 @@
+// Times building the tangent frames of synthetic grid meshes serially and on the worker pool.
+// Usage: tangent-frame-benchmark
+
+// GLM
+#include <glm/glm.hpp>
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "Mesh.hpp"
+
+// a wavy n x n quad grid with uvs across it, two triangles per quad
+static Mesh grid(int n) {
+	Mesh mesh;
+	for (int y = 0; y <= n; y++) {
+		for (int x = 0; x <= n; x++) {
+			const glm::vec2 uv(static_cast<float>(x) / n, static_cast<float>(y) / n);
+			const float height = 0.1f * std::sin(uv.x * 12.0f) * std::cos(uv.y * 9.0f);
+			mesh.vertices.push_back(PosUVVertex{glm::vec3(uv.x * 2.0f - 1.0f, height, 1.0f - uv.y * 2.0f), uv});
+		}
+	}
+	for (int y = 0; y < n; y++) {
+		for (int x = 0; x < n; x++) {
+			const uint32_t i = static_cast<uint32_t>(y * (n + 1) + x);
+			const uint32_t row = static_cast<uint32_t>(n + 1);
+			mesh.indices.insert(mesh.indices.end(), {i, i + 1, i + row + 1, i, i + row + 1, i + row});
+		}
+	}
+	return mesh;
+}
+
+// median milliseconds of a few runs
+static double median_milliseconds(const Mesh &mesh, bool parallel) {
+	std::vector<double> milliseconds;
+	for (int i = 0; i < 5; i++) {
+		const auto start = std::chrono::steady_clock::now();
+		const Mesh::TangentFrames frames = mesh.tangent_frames(parallel);
+		milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		if (frames.vertex_frames.size() != mesh.vertices.size()) std::fprintf(stderr, "Error: Missing tangent frames.\n");
+	}
+	std::sort(milliseconds.begin(), milliseconds.end());
+	return milliseconds[milliseconds.size() / 2];
+}
+
+int main() {
+	std::printf("%u cores\n", std::max(1u, std::thread::hardware_concurrency()));
+	std::printf("%10s %10s %12s %12s %8s\n", "vertices", "triangles", "serial ms", "parallel ms", "speedup");
+	for (int n : {16, 64, 256, 1024, 2048}) {
+		const Mesh mesh = grid(n);
+		median_milliseconds(mesh, true); // starts the worker pool outside of the measurement
+		const double serial = median_milliseconds(mesh, false);
+		const double parallel = median_milliseconds(mesh, true);
+		std::printf("%10zu %10zu %12.3f %12.3f %8.2f\n", mesh.vertices.size(), mesh.indices.size() / 3, serial, parallel, serial / parallel);
+	}
+	return 0;
+}
@@ -0,0 +1,36 @@
+// GLFW
+#include <GLFW/glfw3.h>
+
+#include "BindlessTextures.hpp"
+#include "file_utils.hpp"
+
+BindlessTextures::BindlessTextures() {
+	if (!glfwExtensionSupported("GL_ARB_bindless_texture") || !glfwExtensionSupported("GL_ARB_shader_storage_buffer_object")) return;
+
+	glGetTextureHandleARB = reinterpret_cast<PFNGLGETTEXTUREHANDLEARBPROC>(glfwGetProcAddress("glGetTextureHandleARB"));
+	glMakeTextureHandleResidentARB = reinterpret_cast<PFNGLMAKETEXTUREHANDLERESIDENTARBPROC>(glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+	supported = glGetTextureHandleARB && glMakeTextureHandleResidentARB;
+}
+
+BindlessTextures::~BindlessTextures() {
+	// deleting a texture releases its handle
+	glDeleteTextures(1, &placeholder);
+}
+
+GLuint64 BindlessTextures::handle(GLuint texture) {
+	if (texture == 0) {
+		if (placeholder == 0) {
+			const unsigned char black[4] = {0, 0, 0, 255};
+			placeholder = create_texture(black, 1, 1);
+		}
+		texture = placeholder;
+	}
+
+	auto found = handles.find(texture);
+	if (found != handles.end()) return found->second;
+
+	const GLuint64 handle = glGetTextureHandleARB(texture);
+	glMakeTextureHandleResidentARB(handle);
+	handles.emplace(texture, handle);
+	return handle;
+}
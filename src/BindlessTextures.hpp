@@ -0,0 +1,41 @@
+#ifndef BINDLESS_TEXTURES_HPP
+#define BINDLESS_TEXTURES_HPP
+
+// STD
+#include <unordered_map>
+
+// GLAD
+#include <glad/gl.h>
+
+// Resident 64 bit handles of textures (ARB_bindless_texture), so shaders can sample
+// textures of any size without binding them.
+// The extension is not part of the generated loader, its functions are loaded when available.
+class BindlessTextures {
+public:
+	// loads the extension functions, requires a current context
+	BindlessTextures();
+	~BindlessTextures();
+
+	BindlessTextures(const BindlessTextures &) = delete;
+	BindlessTextures &operator=(const BindlessTextures &) = delete;
+
+	// false if the driver does not support bindless textures and shader storage buffers
+	bool is_supported() const { return supported; }
+
+	// the resident handle of the texture, texture 0 gets a black placeholder
+	// handles stay valid until their texture is deleted
+	GLuint64 handle(GLuint texture);
+
+private:
+	typedef GLuint64 (GLAD_API_PTR *PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+	typedef void (GLAD_API_PTR *PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+
+	PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB = nullptr;
+	PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB = nullptr;
+
+	bool supported = false;
+	GLuint placeholder = 0;
+	std::unordered_map<GLuint, GLuint64> handles;
+};
+
+#endif
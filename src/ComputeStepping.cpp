@@ -0,0 +1,72 @@
+#include "ComputeStepping.hpp"
+#include "file_utils.hpp"
+
+ComputeStepping::ComputeStepping() {
+	ray_program = create_program("ConeStepping.vert", "RelaxedConeStepping.frag", "#define RAY_SETUP\n");
+	step_program = create_compute_program("ConeStepping.comp");
+}
+
+ComputeStepping::~ComputeStepping() {
+	glDeleteProgram(ray_program);
+	glDeleteProgram(step_program);
+	glDeleteFramebuffers(1, &ray_framebuffer);
+	glDeleteTextures(ray_texture_count, ray_textures);
+}
+
+void ComputeStepping::begin_rays(GLuint depth_texture, int width, int height) {
+	// allocated with the first use, the target is reallocated when the window is resized
+	if (width != ray_width || height != ray_height) {
+		glDeleteFramebuffers(1, &ray_framebuffer);
+		glDeleteTextures(ray_texture_count, ray_textures);
+		ray_width = width;
+		ray_height = height;
+
+		// the origins need the precision of the texture coordinates, directions and footprints less
+		const GLenum formats[ray_texture_count] = {GL_RGBA32F, GL_RGBA16F, GL_RGBA16F, GL_RG16I};
+		const GLenum draw_buffers[ray_texture_count] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+		glCreateTextures(GL_TEXTURE_2D, ray_texture_count, ray_textures);
+		glCreateFramebuffers(1, &ray_framebuffer);
+		for (int i = 0; i < ray_texture_count; i++) {
+			glTextureStorage2D(ray_textures[i], 1, formats[i], ray_width, ray_height);
+			glTextureParameteri(ray_textures[i], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTextureParameteri(ray_textures[i], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glNamedFramebufferTexture(ray_framebuffer, draw_buffers[i], ray_textures[i], 0);
+		}
+		glNamedFramebufferDrawBuffers(ray_framebuffer, ray_texture_count, draw_buffers);
+		ray_depth_texture = 0;
+	}
+
+	if (depth_texture != ray_depth_texture) {
+		glNamedFramebufferTexture(ray_framebuffer, GL_DEPTH_ATTACHMENT, depth_texture, 0);
+		ray_depth_texture = depth_texture;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, ray_framebuffer);
+
+	// a direction of 0 marks pixels without a ray, the layers are only read where there is one
+	const GLfloat no_ray[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	for (int i = 0; i < 3; i++) {
+		glClearNamedFramebufferfv(ray_framebuffer, GL_COLOR, i, no_ray);
+	}
+}
+
+void ComputeStepping::step_rays(GLuint color_texture, int width, int height, GLuint stepmap_array, GLuint texmap_array) {
+	glUniform1i(glGetUniformLocation(step_program, "rayOrigins"), 2);
+	glUniform1i(glGetUniformLocation(step_program, "rayDirections"), 3);
+	glUniform1i(glGetUniformLocation(step_program, "rayFootprints"), 4);
+	glUniform1i(glGetUniformLocation(step_program, "rayLayers"), 5);
+	glUniform2i(glGetUniformLocation(step_program, "renderSize"), width, height);
+
+	glBindTextureUnit(0, stepmap_array);
+	glBindTextureUnit(1, texmap_array);
+	for (int i = 0; i < ray_texture_count; i++) {
+		glBindTextureUnit(2 + i, ray_textures[i]);
+	}
+	glBindImageTexture(0, color_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	// one work group per 8x8 tile
+	glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+
+	// the colors are sampled by the passes after
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+}
@@ -0,0 +1,49 @@
+#ifndef COMPUTE_STEPPING_HPP
+#define COMPUTE_STEPPING_HPP
+
+// GLAD
+#include <glad/gl.h>
+
+// Alternative to cone stepping in the fragment shader: the shells are rasterized into the rays of the pixels,
+// which a compute shader steps in 8x8 tiles with the cone map texels of each tile cached in shared memory.
+// Each ray samples the layers of its instance, but all rays sample the same pair of texture arrays,
+// and only the nearest shell of each pixel is stepped, so rays leaving through a side show the background instead of what is behind.
+class ComputeStepping {
+public:
+	// requires a current context
+	ComputeStepping();
+	~ComputeStepping();
+
+	ComputeStepping(const ComputeStepping &) = delete;
+	ComputeStepping &operator=(const ComputeStepping &) = delete;
+
+	// false if the driver does not support compute shaders
+	bool is_supported() const { return ray_program != 0 && step_program != 0; }
+
+	// programs of the passes, they take the uniforms of the cone stepping program
+	GLuint get_ray_program() const { return ray_program; }
+	GLuint get_step_program() const { return step_program; }
+
+	// binds a framebuffer for the rays of the pixels using the depth texture of the target and clears the rays
+	// width and height are the size of the target
+	void begin_rays(GLuint depth_texture, int width, int height);
+
+	// steps the rays within width x height pixels and writes their colors to the color texture (RGBA8),
+	// the step program must be bound
+	// stepmap_array and texmap_array are the texture arrays the shells were drawn with
+	void step_rays(GLuint color_texture, int width, int height, GLuint stepmap_array, GLuint texmap_array);
+
+private:
+	GLuint ray_program = 0;
+	GLuint step_program = 0;
+
+	// origin, direction, footprint and texture layers of the ray of each pixel
+	static constexpr int ray_texture_count = 4;
+	GLuint ray_framebuffer = 0;
+	GLuint ray_textures[ray_texture_count] = {};
+	GLuint ray_depth_texture = 0; // attached depth of the target
+	int ray_width = 0;
+	int ray_height = 0;
+};
+
+#endif
@@ -2,9 +2,18 @@
 #define CONE_MAP_GENERATOR_HPP
 
 // STD
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <memory>
 #include <optional>
 #include <queue>
+#include <stop_token>
 #include <thread>
+#include <vector>
 
 // ImGui
 #include "imgui.h"
@@ -13,43 +22,122 @@
 // Cone map generation
 #include "conemap.hpp"
 
-template <typename T>
-class ThreadSafeQueue {
-	std::queue<T> q;
-	std::mutex m;
+#include "image_io.hpp"
+#include "MpmcQueue.hpp"
+#include "telemetry.hpp"
+#include "tiled_generation.hpp"
+
+// a queued cone map generation
+struct GenerationJob {
+	enum class State { Queued, Running, Finished, Failed, Cancelled };
+
+	int id;
+	std::filesystem::path input;
+	std::filesystem::path output_directory; // copied when queued, the gui may change its setting meanwhile
+	int mode; // wrap << 2 | analytic << 1 | depthmap
+	int tile_size; // 0 if not tiled, set by the worker when the input exceeds max_untiled_size
+	int overlap; // tile overlap in texels
+	int max_untiled_size; // larger inputs are tiled at this size anyway, so they report progress and can be cancelled
+
+	std::atomic<int> priority = 0; // higher runs first
+	std::stop_source cancel; // honored between tiles, untiled jobs only before they start
+	std::atomic<State> state = State::Queued;
+	std::atomic<float> progress = 0.0f;
+	std::atomic<bool> tiled_for_size = false; // tile_size was set by the worker
+
+	// steady clock nanoseconds
+	std::atomic<int64_t> start_time = 0;
+	std::atomic<int64_t> end_time = 0;
+
+	// measurements of the run, written by the worker before it stores the final state
+	struct Telemetry {
+		int width = 0; // of the input
+		int height = 0;
+		double wall_time = 0.0; // seconds
+		double thread_cpu_time = 0.0; // seconds on the generation thread
+		double process_cpu_time = 0.0; // seconds on all threads, includes rendering but also threads of the generation library
+		size_t peak_rss = 0; // bytes, of the whole process
+		bool peak_rss_reset = false; // false if peak_rss is the peak since program start
+
+		double megatexels_per_second() const {
+			return wall_time > 0.0 ? width * static_cast<double>(height) * 1e-6 / wall_time : 0.0;
+		}
+	} telemetry;
+	bool recorded = false; // added to the statistics, only accessed by the gui
 
-public:
-	void push(T v) {
-		std::lock_guard<std::mutex> lock(m);
-		q.push(std::move(v));
+	GenerationJob(int id_, const std::filesystem::path &input_, const std::filesystem::path &output_directory_, int mode_, int tile_size_, int overlap_, int max_untiled_size_, int priority_)
+			: id(id_), input(input_), output_directory(output_directory_), mode(mode_), tile_size(tile_size_), overlap(overlap_), max_untiled_size(max_untiled_size_), priority(priority_) {}
+
+	static int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
-	std::optional<T> try_pop() {
-		std::lock_guard<std::mutex> lock(m);
-		if (q.empty()) return std::nullopt;
-		T v = std::move(q.front());
-		q.pop();
-		return v;
+	// seconds spent running so far
+	double elapsed() const {
+		const int64_t start = start_time.load();
+		if (!start) return 0.0;
+		const int64_t end = end_time.load();
+		return ((end ? end : now()) - start) * 1e-9;
 	}
 
-	bool empty() {
-		std::lock_guard<std::mutex> lock(m);
-		return q.empty();
+	bool active() const {
+		const State s = state.load();
+		return s == State::Queued || s == State::Running;
+	}
+
+	static const char *state_name(State s) {
+		static const char *names[] = {"Queued", "Running", "Finished", "Failed", "Cancelled"};
+		return names[static_cast<int>(s)];
 	}
 };
 
 class ConeMapGenerator {
 	int generation_mode = 0;
 	int height_mode = 0;
+	bool wrap = false; // tileable cone maps
+	int priority = 0; // of new jobs
+
+	// tiled generation for height maps larger than memory
+	bool tiled = false;
+	int tile_size = 2048;
+	int tile_overlap = 256; // texels around a tile the generator sees, cones are clamped to it
+	// a single call of the generator can neither be stopped nor report progress, so larger inputs are always tiled
+	int max_untiled_size = 4096;
 
-	ThreadSafeQueue<std::pair<std::filesystem::path, int>> input_queue;
-	ThreadSafeQueue<std::filesystem::path> output_queue;
+	// all jobs in submission order, only accessed by the gui
+	std::vector<std::shared_ptr<GenerationJob>> jobs;
+	int next_id = 1;
+
+	// jobs handed to the worker, and the ones that did not fit yet
+	MpmcQueue<std::shared_ptr<GenerationJob>> input_queue{1024};
+	std::vector<std::shared_ptr<GenerationJob>> unsubmitted;
+
+	MpmcQueue<GeneratedConeMap> output_queue{64};
+
+	// generated cone maps handed over in memory are written to disk in the background
+	MpmcQueue<GeneratedConeMap> write_queue{64};
+	// paths of the finished writes, for the gui to index once the files are complete
+	MpmcQueue<std::filesystem::path> written_queue{64};
 
-	std::counting_semaphore<> sem{0}; // initially 0
 	std::jthread worker;
-	std::atomic<bool> processing;
+	std::jthread file_writer;
+
+	std::filesystem::path output_path = std::filesystem::current_path(); // gui thread only, jobs keep a copy
+
+	// telemetry of every job, one JSON object per line
+	std::filesystem::path log_path;
 
-	std::filesystem::path output_path = std::filesystem::current_path();
+	// totals of the finished jobs, only accessed by the gui
+	struct Statistics {
+		int jobs = 0;
+		double megatexels = 0.0;
+		double wall_time = 0.0;
+		double thread_cpu_time = 0.0;
+		double process_cpu_time = 0.0;
+		size_t peak_rss = 0;
+	};
+	static constexpr const char *statistics_names[4] = {"Discrete", "Analytic", "Discrete tiled", "Analytic tiled"};
+	Statistics statistics[4]; // analytic + 2 * (tiled or wrapped)
 
 	ImGui::FileBrowser directory_selector = ImGui::FileBrowser(
 			ImGuiFileBrowserFlags_SelectDirectory |
@@ -64,6 +152,258 @@ class ConeMapGenerator {
 			ImGuiFileBrowserFlags_EditPathString
 			);
 
+	// highest priority job, oldest first among equals
+	// pending is only accessed by the worker, it collects the submitted jobs so their priorities can be compared
+	std::shared_ptr<GenerationJob> take_job(std::vector<std::shared_ptr<GenerationJob>> &pending, std::stop_token stoken) {
+		while (std::optional<std::shared_ptr<GenerationJob>> job = input_queue.try_pop()) {
+			pending.push_back(std::move(*job));
+		}
+
+		// wait until at least one job is queued
+		if (pending.empty()) {
+			std::optional<std::shared_ptr<GenerationJob>> job = input_queue.pop(stoken);
+			if (!job) return nullptr;
+			pending.push_back(std::move(*job));
+		}
+
+		auto it = std::max_element(pending.begin(), pending.end(),
+				[](const std::shared_ptr<GenerationJob> &a, const std::shared_ptr<GenerationJob> &b) {
+					const int pa = a->priority.load();
+					const int pb = b->priority.load();
+					return pa < pb || (pa == pb && a->id > b->id);
+				});
+		std::shared_ptr<GenerationJob> job = *it;
+		pending.erase(it);
+		return job;
+	}
+
+	void run(GenerationJob &job, std::stop_token stoken) {
+		GenerationJob::Telemetry &telemetry = job.telemetry;
+		int channels;
+		read_image_info(job.input, telemetry.width, telemetry.height, channels);
+		if (job.tile_size == 0 && std::max(telemetry.width, telemetry.height) > job.max_untiled_size) {
+			job.tile_size = job.max_untiled_size;
+			job.tiled_for_size.store(true);
+		}
+		telemetry.peak_rss_reset = reset_peak_rss();
+		const double thread_cpu_start = thread_cpu_seconds();
+		const double process_cpu_start = process_cpu_seconds();
+
+		job.start_time.store(GenerationJob::now());
+		job.state.store(GenerationJob::State::Running);
+
+		bool wrap_input = (job.mode >> 2) & 1;
+		bool analytic = (job.mode >> 1) & 1;
+		bool depthmap = job.mode & 1;
+
+		GeneratedConeMap output;
+		if (job.tile_size > 0 || wrap_input) {
+			// wrapping needs the neighborhood from the opposite edges, which the generator does not support
+			// so the image is generated as a tile with toroidal overlap
+			// the generator still encodes and decodes every tile as a PNG, only the assembled result skips the disk
+			output = generate_tiled(job.output_directory, job.input, analytic, depthmap, job.tile_size, job.overlap, wrap_input,
+					job.cancel.get_token(), [&job](float progress) { job.progress.store(progress); }, true);
+		} else {
+			if (analytic) {
+				output.path = conemap::analytic(job.output_directory, job.input, depthmap);
+			} else {
+				output.path = conemap::discrete(job.output_directory, job.input, depthmap);
+			}
+
+			// the generator only takes and writes files (conemap.hpp has no buffer interface),
+			// so the PNG it encoded is decoded again here, on the worker so the render thread does not have to
+			if (!output.path.empty()) {
+				int channels;
+				std::vector<unsigned char> pixels = load_image_rgba(output.path, output.width, output.height, channels);
+				if (!pixels.empty() && channels == 4) {
+					output.pixels = std::make_shared<const std::vector<unsigned char>>(std::move(pixels));
+				}
+			}
+		}
+
+		job.end_time.store(GenerationJob::now());
+
+		telemetry.wall_time = (job.end_time.load() - job.start_time.load()) * 1e-9;
+		telemetry.thread_cpu_time = thread_cpu_seconds() - thread_cpu_start;
+		telemetry.process_cpu_time = process_cpu_seconds() - process_cpu_start;
+		telemetry.peak_rss = peak_rss_bytes();
+
+		if (job.cancel.stop_requested()) {
+			job.state.store(GenerationJob::State::Cancelled);
+		} else if (output.path.empty()) {
+			job.state.store(GenerationJob::State::Failed);
+		} else {
+			job.progress.store(1.0f);
+			job.state.store(GenerationJob::State::Finished);
+		}
+
+		log(job, output.path);
+
+		if (job.state.load() == GenerationJob::State::Finished) {
+			if (!output.written) {
+				write_queue.push(output, stoken);
+			}
+
+			// Push result
+			output_queue.push(std::move(output), stoken);
+		}
+	}
+
+	void log(const GenerationJob &job, const std::filesystem::path &output) {
+		if (log_path.empty()) return;
+
+		std::ofstream log_file(log_path, std::ios::out | std::ios::app);
+		if (!log_file.is_open()) return;
+
+		const GenerationJob::Telemetry &t = job.telemetry;
+		char measurements[512];
+		std::snprintf(measurements, sizeof(measurements),
+				"\"width\":%d,\"height\":%d,\"wall_s\":%.3f,\"thread_cpu_s\":%.3f,\"process_cpu_s\":%.3f,"
+				"\"peak_rss_mib\":%.1f,\"peak_rss_since_start\":%s,\"mtexel_per_s\":%.3f",
+				t.width, t.height, t.wall_time, t.thread_cpu_time, t.process_cpu_time,
+				t.peak_rss / (1024.0 * 1024.0), t.peak_rss_reset ? "false" : "true", t.megatexels_per_second());
+
+		log_file << "{\"time\":" << std::time(nullptr)
+			<< ",\"input\":" << json_string(job.input.string())
+			<< ",\"output\":" << json_string(output.string())
+			<< ",\"generator\":" << (((job.mode >> 1) & 1) ? "\"analytic\"" : "\"discrete\"")
+			<< ",\"depth_map\":" << ((job.mode & 1) ? "true" : "false")
+			<< ",\"wrap\":" << (((job.mode >> 2) & 1) ? "true" : "false")
+			<< ",\"tile_size\":" << job.tile_size
+			<< ",\"state\":" << json_string(GenerationJob::state_name(job.state.load()))
+			<< "," << measurements << "}\n";
+	}
+
+	void compose_jobs() {
+		for (const std::shared_ptr<GenerationJob> &job : jobs) {
+			if (job->recorded || job->state.load() != GenerationJob::State::Finished) continue;
+			job->recorded = true;
+
+			const GenerationJob::Telemetry &t = job->telemetry;
+			Statistics &s = statistics[((job->mode >> 1) & 1) + 2 * (job->tile_size > 0 || ((job->mode >> 2) & 1))];
+			s.jobs++;
+			s.megatexels += t.width * static_cast<double>(t.height) * 1e-6;
+			s.wall_time += t.wall_time;
+			s.thread_cpu_time += t.thread_cpu_time;
+			s.process_cpu_time += t.process_cpu_time;
+			s.peak_rss = std::max(s.peak_rss, t.peak_rss);
+		}
+
+		if (jobs.empty()) {
+			compose_statistics();
+			return;
+		}
+
+		if (ImGui::BeginTable("Jobs", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable,
+					ImVec2(0.0f, 10 * ImGui::GetTextLineHeightWithSpacing()))) {
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("ID", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableSetupColumn("Input");
+			ImGui::TableSetupColumn("Priority", ImGuiTableColumnFlags_WidthFixed, 6 * ImGui::GetFontSize());
+			ImGui::TableSetupColumn("State", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableSetupColumn("Progress");
+			ImGui::TableSetupColumn("Time", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableHeadersRow();
+
+			for (const std::shared_ptr<GenerationJob> &job : jobs) {
+				const GenerationJob::State state = job->state.load();
+				ImGui::PushID(job->id);
+				ImGui::TableNextRow();
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%d", job->id);
+
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(job->input.filename().c_str());
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("%s", job->input.c_str());
+
+				ImGui::TableNextColumn();
+				int job_priority = job->priority.load();
+				ImGui::BeginDisabled(state != GenerationJob::State::Queued); // only pending jobs can be reordered
+					ImGui::SetNextItemWidth(-FLT_MIN);
+					if (ImGui::InputInt("##priority", &job_priority)) {
+						job->priority.store(job_priority);
+					}
+				ImGui::EndDisabled();
+
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(GenerationJob::state_name(state));
+				if (job->tiled_for_size.load()) {
+					ImGui::SameLine();
+					ImGui::TextDisabled("(tiled)");
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("Larger than %d texels, generated in tiles so it can be cancelled", job->max_untiled_size);
+				}
+
+				ImGui::TableNextColumn();
+				ImGui::ProgressBar(job->progress.load(), ImVec2(-FLT_MIN, 0.0f));
+
+				ImGui::TableNextColumn();
+				ImGui::Text("%.1f s", job->elapsed());
+				if (!job->active() && job->start_time.load() && ImGui::IsItemHovered()) {
+					const GenerationJob::Telemetry &t = job->telemetry;
+					ImGui::SetTooltip("%d x %d\nCPU: %.1f s (generation thread), %.1f s (process)\nPeak RSS: %.0f MiB\n%.2f MTexel/s",
+							t.width, t.height, t.thread_cpu_time, t.process_cpu_time, t.peak_rss / (1024.0 * 1024.0), t.megatexels_per_second());
+				}
+
+				ImGui::TableNextColumn();
+				ImGui::BeginDisabled(!job->active() || job->cancel.stop_requested());
+					if (ImGui::SmallButton("Cancel")) {
+						job->cancel.request_stop();
+					}
+				ImGui::EndDisabled();
+
+				ImGui::PopID();
+			}
+			ImGui::EndTable();
+		}
+
+		if (ImGui::Button("Clear finished")) {
+			std::erase_if(jobs, [](const std::shared_ptr<GenerationJob> &job) { return !job->active(); });
+		}
+
+		compose_statistics();
+	}
+
+	void compose_statistics() {
+		if (!ImGui::TreeNode("Statistics")) return;
+
+		if (ImGui::BeginTable("Statistics", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Generator");
+			ImGui::TableSetupColumn("Jobs");
+			ImGui::TableSetupColumn("MTexel/s");
+			ImGui::TableSetupColumn("Wall");
+			ImGui::TableSetupColumn("Thread CPU");
+			ImGui::TableSetupColumn("Process CPU");
+			ImGui::TableSetupColumn("Peak RSS");
+			ImGui::TableHeadersRow();
+
+			for (int i = 0; i < 4; i++) {
+				const Statistics &s = statistics[i];
+				if (!s.jobs) continue;
+
+				// throughput over all texels, times are means per job
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(statistics_names[i]);
+				ImGui::TableNextColumn(); ImGui::Text("%d", s.jobs);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", s.wall_time > 0.0 ? s.megatexels / s.wall_time : 0.0);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f s", s.wall_time / s.jobs);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f s", s.thread_cpu_time / s.jobs);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f s", s.process_cpu_time / s.jobs);
+				ImGui::TableNextColumn(); ImGui::Text("%.0f MiB", s.peak_rss / (1024.0 * 1024.0));
+			}
+			ImGui::EndTable();
+		}
+
+		if (!log_path.empty()) {
+			ImGui::TextDisabled("Log: %s", log_path.c_str());
+		}
+
+		ImGui::TreePop();
+	}
+
 public:
 	ConeMapGenerator() {
 		directory_selector.SetTitle("Cone map generation output directory");
@@ -71,43 +411,104 @@ public:
 		file_selector.SetTypeFilters({".png", ".jpg", ".jpeg"});
 		file_selector.SetTitle("Cone map generation input");
 
+		std::filesystem::path log_directory = state_directory();
+		if (!log_directory.empty()) {
+			std::error_code ec;
+			std::filesystem::create_directories(log_directory, ec);
+			if (ec) {
+				std::fprintf(stderr, "Error: Could not create log directory %s.\n", log_directory.c_str());
+			} else {
+				log_path = log_directory / "generation.jsonl";
+			}
+		}
+
 		// start worker thread
 		worker = std::jthread([this](std::stop_token stoken) {
+			std::vector<std::shared_ptr<GenerationJob>> pending;
 			while (!stoken.stop_requested()) {
-				// wait until at least one input is queued
-				sem.acquire();
+				std::shared_ptr<GenerationJob> job = take_job(pending, stoken);
+				if (!job) break; // stop was requested while waiting
 
-				// check again, in case stop was requested while waiting
-				if (stoken.stop_requested()) break;
-
-				std::optional<std::pair<std::filesystem::path, int>> input = input_queue.try_pop();
+				// cancelled while waiting
+				if (job->cancel.stop_requested()) {
+					job->state.store(GenerationJob::State::Cancelled);
+					continue;
+				}
 
-				processing.store(true);
-				
-				bool analytic = input->second >> 1;
-				bool depthmap = input->second & 1;
+				run(*job, stoken);
+			}
+		});
 
-				std::filesystem::path output;
-				if (analytic) {
-					output = conemap::analytic(output_path, input->first, depthmap);
-				} else {
-					output = conemap::discrete(output_path, input->first, depthmap);
+		// start file writer thread
+		file_writer = std::jthread([this](std::stop_token stoken) {
+			auto write = [this](const GeneratedConeMap &cone_map) {
+				if (!write_png(cone_map.path, cone_map.pixels->data(), cone_map.width, cone_map.height, 4)) {
+					std::fprintf(stderr, "Error: Could not write %s.\n", cone_map.path.c_str());
+					return;
 				}
+				// never blocks, if the gui falls that far behind the file is just not indexed
+				written_queue.try_push(cone_map.path);
+			};
 
-				// Push result
-				output_queue.push(output);
+			while (std::optional<GeneratedConeMap> cone_map = write_queue.pop(stoken)) {
+				write(*cone_map);
+			}
 
-				processing.store(false);
+			// finish the remaining writes before exiting
+			while (std::optional<GeneratedConeMap> cone_map = write_queue.try_pop()) {
+				write(*cone_map);
 			}
 		});
 	}
 
 	~ConeMapGenerator() {
+		// stop the running job as well
+		for (const std::shared_ptr<GenerationJob> &job : jobs) job->cancel.request_stop();
 		worker.request_stop();
-		sem.release();
+		worker.join();
+		file_writer.request_stop();
+		file_writer.join();
 	}
 
-	std::filesystem::path compose() {
+	// queues inputs with the current settings
+	void generate(const std::vector<std::filesystem::path> &input_files) {
+		for (std::filesystem::path input : input_files) {
+			auto job = std::make_shared<GenerationJob>(next_id++, input, output_path,
+					(wrap << 2) + (generation_mode << 1) + height_mode, tiled ? tile_size : 0, tile_overlap, max_untiled_size, priority);
+			jobs.push_back(job);
+			unsubmitted.push_back(job);
+		}
+		submit();
+	}
+
+	// hands jobs to the worker without blocking, the ones that do not fit are retried next frame
+	void submit() {
+		auto it = unsubmitted.begin();
+		while (it != unsubmitted.end() && input_queue.try_push(*it)) ++it;
+		unsubmitted.erase(unsubmitted.begin(), it);
+	}
+
+	// queues inputs with the given settings, which also become the settings shown in the window
+	void generate(const std::vector<std::filesystem::path> &input_files, bool analytic, bool depthmap, bool wrap_) {
+		generation_mode = analytic;
+		height_mode = depthmap;
+		wrap = wrap_;
+		generate(input_files);
+	}
+
+	// true while jobs are queued or running or their results are not taken yet
+	bool busy() const {
+		return !unsubmitted.empty() || !output_queue.empty() ||
+				std::any_of(jobs.begin(), jobs.end(), [](const std::shared_ptr<GenerationJob> &job) { return job->active(); });
+	}
+
+	// returns a cone map written to disk in the background since the last call, if any
+	std::optional<std::filesystem::path> written() {
+		return written_queue.try_pop();
+	}
+
+	// returns the cone map generated since the last frame, if any
+	std::optional<GeneratedConeMap> compose() {
 		ImGui::TextWrapped("Cone map generation output directory:\n%s", output_path.c_str());
 		if (ImGui::Button("Change")) {
 			directory_selector.Open();
@@ -127,7 +528,19 @@ public:
 		ImGui::RadioButton("Height map", &height_mode, 0);
 		ImGui::RadioButton("Depth map", &height_mode, 1);
 
-		// TODO wrapping texture
+		ImGui::Checkbox("Tileable", &wrap);
+		ImGui::Checkbox("Tiled", &tiled); // streamed from PNG files, other inputs are decoded whole
+		ImGui::BeginDisabled(!tiled);
+			if (ImGui::InputInt("Tile size", &tile_size, 256, 1024)) tile_size = std::max(tile_size, 1);
+		ImGui::EndDisabled();
+		if (ImGui::InputInt("Tile overlap", &tile_overlap, 16, 128)) tile_overlap = std::max(tile_overlap, 1);
+		ImGui::BeginDisabled(tiled);
+			// only inputs up to this size run as one uncancellable call of the generator
+			if (ImGui::InputInt("Largest untiled size", &max_untiled_size, 256, 1024)) max_untiled_size = std::max(max_untiled_size, 1);
+		ImGui::EndDisabled();
+
+		ImGui::InputInt("Priority", &priority);
+
 		if (ImGui::Button("Generate cone map from texture")) {
 			file_selector.Open();
 		}
@@ -139,22 +552,13 @@ public:
 			input_files = file_selector.GetMultiSelected();
 			file_selector.ClearSelected();
 
-			for (std::filesystem::path input : input_files) {
-				input_queue.push({input, (generation_mode << 1) + height_mode});
-				// signal that an input can be processed
-				sem.release();
-			}
+			generate(input_files);
 		}
 
-		std::optional<std::filesystem::path> output = output_queue.try_pop();
+		submit();
+		compose_jobs();
 
-		ImGui::TextColored(ImVec4(1, 1, 0, 1), // yellow
-				"%s", processing.load() ? "Generating in progress" : "");
-
-		if (output) {
-			return *output;
-		}
-		return "";
+		return output_queue.try_pop();
 	}
 };
 
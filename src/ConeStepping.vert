@@ -2,10 +2,16 @@
 
 // vertex attributes
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inTangent;
-layout(location = 3) in vec3 inBitangent;
-layout(location = 4) in vec2 inTexCoord;
+layout(location = 1) in vec4 inTangentFrame; // quaternion, w < 0 if the bitangent is mirrored
+layout(location = 2) in vec2 inTexCoord; // relative to the uv bounds of the mesh
+
+// instance attributes
+layout(location = 3) in mat4 inWorldMatrix;
+layout(location = 7) in float inDepthScale;
+layout(location = 8) in ivec2 inLayers; // cone map and texture array layers
+
+// shell attributes
+layout(location = 9) in float inShellHeight; // 1 on the mesh, 0 at the bottom of the side walls
 
 // outputs to fragment shader
 out vec2 texCoord;
@@ -13,27 +19,55 @@ out vec3 eyeSpaceVert;
 out vec3 eyeSpaceTangent;
 out vec3 eyeSpaceBitangent;
 out vec3 eyeSpaceNormal;
+out float eyeSpaceDepth;
+out float entryHeight; // height in the height field where the ray enters
+flat out float depth;
+flat out ivec2 layers;
 
 // uniforms
-uniform mat4 worldViewMatrix;
+uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
+uniform vec4 uvTransform; // offset in xy, scale in zw
+uniform float objectDepth;
+uniform float uvToWorld; // object space length of a unit in uv space
+
+// the depth prepass and the shading pass must compute the same depths
+invariant gl_Position;
 
 void main()
 {
 		// pass through texture coordinates
-		texCoord = inTexCoord;
+		texCoord = uvTransform.xy + inTexCoord * uvTransform.zw;
+
+		// depth of this instance
+		depth = objectDepth * inDepthScale;
+		layers = inLayers;
+
+		// tangent frame from the first and last column of the rotation matrix of the quaternion
+		vec4 q = normalize(inTangentFrame);
+		vec3 tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.z * q.w), 2.0 * (q.x * q.z - q.y * q.w));
+		vec3 normal = vec3(2.0 * (q.x * q.z + q.y * q.w), 2.0 * (q.y * q.z - q.x * q.w), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+		vec3 bitangent = (q.w < 0.0 ? -1.0 : 1.0) * cross(normal, tangent);
+
+		// wall vertices are moved down to the bottom of the height field
+		entryHeight = inShellHeight;
+		vec3 position = inPosition - normal * (1.0 - inShellHeight) * depth * uvToWorld;
 
 		// transform vertex position to eye space
-		vec4 viewPos	= worldViewMatrix * vec4(inPosition, 1.0);
+		mat4 worldViewMatrix = viewMatrix * inWorldMatrix;
+		vec4 viewPos	= worldViewMatrix * vec4(position, 1.0);
 		eyeSpaceVert = viewPos.xyz;
 
 		// compute world-space to eye-space transform for normals/tangents
 		mat3 normalMatrix = mat3(worldViewMatrix);
 
+		// height field depth, scaled like the normal direction
+		eyeSpaceDepth = depth * uvToWorld * length(normalMatrix * normal);
+
 		// transform normal, tangent, and binormal to eye space
-		eyeSpaceNormal	 = normalize(normalMatrix * inNormal);
-		eyeSpaceTangent	 = normalize(normalMatrix * inTangent);
-		eyeSpaceBitangent = normalize(normalMatrix * inBitangent);
+		eyeSpaceNormal	 = normalize(normalMatrix * normal);
+		eyeSpaceTangent	 = normalize(normalMatrix * tangent);
+		eyeSpaceBitangent = normalize(normalMatrix * bitangent);
 
 		// final clip-space position
 		gl_Position = projectionMatrix * viewPos;
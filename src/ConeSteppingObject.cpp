@@ -3,48 +3,126 @@
 
 // GLM
 #include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 
 #include "ConeSteppingObject.hpp"
 
-ConeSteppingObject::ConeSteppingObject(const std::vector<PosUVVertex> vertices) {
-	// vertex structure
+ConeSteppingObject::ConeSteppingObject(const std::vector<PosUVVertex> vertices)
+		: ConeSteppingObject(Mesh::from_triangles(vertices)) {}
+
+ConeSteppingObject::ConeSteppingObject(const Mesh &mesh) {
+	// vertex structure, the vertex shader reconstructs normal, tangent and bitangent from the quaternion
 	struct ConeSteppingVertex {
 		glm::vec3 pos;
-		glm::vec3 normal;
-		glm::vec3 tangent;
-		glm::vec3 bitangent;
-		glm::vec2 uv;
+		int16_t tangent_frame[4]; // normalized quaternion xyzw, w < 0 if the bitangent is mirrored
+		uint16_t uv[2]; // normalized within the uv bounds of the mesh
+	};
+	static_assert(sizeof(ConeSteppingVertex) == 24);
+
+	const size_t vertex_count = mesh.vertices.size();
+	const size_t triangle_count = mesh.indices.size() / 3;
+
+	// rotation of the tangent frame of every vertex, with the face normals it was built from
+	const Mesh::TangentFrames frames = mesh.tangent_frames();
+	const std::vector<glm::vec3> &face_normals = frames.face_normals;
+
+	// bounds, scale of the texture mapping and normal cone
+	bounds_min = glm::vec3(std::numeric_limits<float>::max());
+	bounds_max = glm::vec3(std::numeric_limits<float>::lowest());
+	for (const PosUVVertex &vertex : mesh.vertices) {
+		bounds_min = glm::min(bounds_min, vertex.pos);
+		bounds_max = glm::max(bounds_max, vertex.pos);
+	}
+	if (mesh.vertices.empty()) bounds_min = bounds_max = glm::vec3(0.0f);
+
+	double area = 0.0;
+	double uv_area = 0.0;
+	glm::vec3 normal_sum(0.0f);
+	for (size_t f = 0; f < triangle_count; f++) {
+		const glm::vec2 uv0 = mesh.vertices[mesh.indices[3 * f]].uv;
+		const glm::vec2 duv1 = mesh.vertices[mesh.indices[3 * f + 1]].uv - uv0;
+		const glm::vec2 duv2 = mesh.vertices[mesh.indices[3 * f + 2]].uv - uv0;
+		area += glm::length(face_normals[f]);
+		uv_area += std::abs(duv1.x * duv2.y - duv1.y * duv2.x);
+		if (glm::length(face_normals[f]) > 0.0f) normal_sum += glm::normalize(face_normals[f]);
+	}
+	uv_to_world = uv_area > 0.0 ? static_cast<float>(std::sqrt(area / uv_area)) : 1.0f;
+
+	normal_cone_axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+	float min_cos = 1.0f;
+	for (const glm::vec3 &face_normal : face_normals) {
+		if (glm::length(face_normal) > 0.0f) min_cos = std::min(min_cos, glm::dot(normal_cone_axis, glm::normalize(face_normal)));
+	}
+	normal_cone_cutoff = min_cos > 0.1f ? std::sqrt(1.0f - min_cos * min_cos) : 1.0f;
+
+	// 16 bit uvs relative to the bounds are more precise than half floats, which resolve [0.5, 1] only in steps of 1/2048
+	glm::vec2 uv_min(std::numeric_limits<float>::max());
+	glm::vec2 uv_max(std::numeric_limits<float>::lowest());
+	for (const PosUVVertex &vertex : mesh.vertices) {
+		uv_min = glm::min(uv_min, vertex.uv);
+		uv_max = glm::max(uv_max, vertex.uv);
+	}
+	if (mesh.vertices.empty()) uv_min = uv_max = glm::vec2(0.0f);
+	const glm::vec2 uv_extent = uv_max - uv_min;
+	uv_transform = glm::vec4(uv_min.x, uv_min.y, uv_extent.x, uv_extent.y);
+
+	auto quantize_uv = [](float uv, float min, float extent) -> uint16_t {
+		return extent > 0.0f ? static_cast<uint16_t>(std::lround(std::clamp((uv - min) / extent, 0.0f, 1.0f) * 65535.0f)) : 0;
+	};
+	auto quantize_snorm = [](float x) -> int16_t {
+		return static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
 	};
 
 	// vertices to be sent to GPU
-	std::vector<ConeSteppingVertex> csvs;
-
-	// find the tangent and bitangent and normal for each triangle face
-	for (size_t i = 0; i < vertices.size(); i += 3) {
-		glm::vec3 dp1 = vertices[i + 1].pos - vertices[i].pos;
-		glm::vec3 dp2 = vertices[i + 2].pos - vertices[i].pos;
-		glm::vec2 duv1 = vertices[i + 1].uv - vertices[i].uv;
-		glm::vec2 duv2 = vertices[i + 2].uv - vertices[i].uv;
-
-		// duv1 and duv2 form a base in the uv plane
-		// we are looking for the inverse, which transforms these vectors to u and v
-
-		// we multiply the corresponding dp1 and dp2 with the inverse to get the
-		// 3D object space direction vectors corresponding to u and v
-		
-		float det = 1.0f / (duv1.x * duv2.y - duv1.y * duv2.x);
-
-		glm::vec3 tangent = det * (dp1 * duv2.y - dp2 * duv1.y);
-		glm::vec3 bitangent = det * (dp2 * duv1.x - dp1 * duv2.x); // z faces the other way
-		
-		// the normal is ortogonal to both tangent and bitangent
-		glm::vec3 normal = glm::cross(tangent, bitangent);
-
-		csvs.push_back(ConeSteppingVertex{vertices[i].pos, normal, tangent, bitangent, vertices[i].uv});
-		csvs.push_back(ConeSteppingVertex{vertices[i + 1].pos, normal, tangent, bitangent, vertices[i + 1].uv});
-		csvs.push_back(ConeSteppingVertex{vertices[i + 2].pos, normal, tangent, bitangent, vertices[i + 2].uv});
+	std::vector<ConeSteppingVertex> csvs(vertex_count);
+
+	for (size_t v = 0; v < vertex_count; v++) {
+		const glm::quat &q = frames.vertex_frames[v];
+		const glm::vec2 uv = mesh.vertices[v].uv;
+		csvs[v] = ConeSteppingVertex{mesh.vertices[v].pos,
+				{quantize_snorm(q.x), quantize_snorm(q.y), quantize_snorm(q.z), quantize_snorm(q.w)},
+				{quantize_uv(uv.x, uv_min.x, uv_extent.x), quantize_uv(uv.y, uv_min.y, uv_extent.y)}};
 	}
 
+	// shell walls, quads from the boundary edges down to copies of their vertices moved to the bottom by the vertex shader
+	std::vector<uint32_t> indices = mesh.indices;
+	std::vector<uint8_t> shell_heights(vertex_count, 255);
+	std::vector<uint32_t> bottom(vertex_count, UINT32_MAX);
+	auto bottom_of = [&](uint32_t v) {
+		if (bottom[v] == UINT32_MAX) {
+			bottom[v] = static_cast<uint32_t>(csvs.size());
+			const ConeSteppingVertex copy = csvs[v];
+			csvs.push_back(copy);
+			shell_heights.push_back(0);
+		}
+		return bottom[v];
+	};
+
+	const glm::vec2 uv_tolerance = 1e-4f * uv_extent;
+	auto on_uv_bounds = [&](uint32_t v) {
+		const glm::vec2 uv = mesh.vertices[v].uv;
+		return std::abs(uv.x - uv_min.x) <= uv_tolerance.x || std::abs(uv.x - uv_max.x) <= uv_tolerance.x ||
+				std::abs(uv.y - uv_min.y) <= uv_tolerance.y || std::abs(uv.y - uv_max.y) <= uv_tolerance.y;
+	};
+
+	const std::vector<std::pair<uint32_t, uint32_t>> boundary = mesh.boundary_edges();
+	boundary_on_uv_bounds = !boundary.empty();
+	for (auto [a, b] : boundary) {
+		// the interior is left of a -> b, so this winding faces outwards
+		const uint32_t a_bottom = bottom_of(a);
+		const uint32_t b_bottom = bottom_of(b);
+		indices.insert(indices.end(), {a, a_bottom, b_bottom, a, b_bottom, b});
+		boundary_on_uv_bounds = boundary_on_uv_bounds && on_uv_bounds(a) && on_uv_bounds(b);
+	}
+
+	index_count = static_cast<GLsizei>(indices.size());
+
 	// create VAO
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
@@ -55,34 +133,42 @@ ConeSteppingObject::ConeSteppingObject(const std::vector<PosUVVertex> vertices)
 	glBufferData(GL_ARRAY_BUFFER, csvs.size() * sizeof(ConeSteppingVertex), csvs.data(),
 							 GL_STATIC_DRAW);
 
+	// create EBO, stays bound to the VAO
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(),
+							 GL_STATIC_DRAW);
+
 	// setup VAO
 	glEnableVertexAttribArray(0); // position
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ConeSteppingVertex),
 												(void *)offsetof(ConeSteppingVertex, pos));
 
-	glEnableVertexAttribArray(1); // normal
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ConeSteppingVertex),
-												(void *)offsetof(ConeSteppingVertex, normal));
+	glEnableVertexAttribArray(1); // tangent frame
+	glVertexAttribPointer(1, 4, GL_SHORT, GL_TRUE, sizeof(ConeSteppingVertex),
+												(void *)offsetof(ConeSteppingVertex, tangent_frame));
 
-	glEnableVertexAttribArray(2); // tangent
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ConeSteppingVertex),
-												(void *)offsetof(ConeSteppingVertex, tangent));
+	glEnableVertexAttribArray(2); // uv
+	glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(ConeSteppingVertex),
+												(void *)offsetof(ConeSteppingVertex, uv));
 
-	glEnableVertexAttribArray(3); // binormal
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(ConeSteppingVertex),
-												(void *)offsetof(ConeSteppingVertex, bitangent));
+	// shell heights in a separate buffer, keeping the vertex at 24 bytes
+	glGenBuffers(1, &shell_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, shell_vbo);
+	glBufferData(GL_ARRAY_BUFFER, shell_heights.size(), shell_heights.data(), GL_STATIC_DRAW);
 
-	glEnableVertexAttribArray(4); // uv
-	glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(ConeSteppingVertex),
-												(void *)offsetof(ConeSteppingVertex, uv));
+	glEnableVertexAttribArray(9); // shell height
+	glVertexAttribPointer(9, 1, GL_UNSIGNED_BYTE, GL_TRUE, 1, (void *)0);
 
 	// unbind
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 ConeSteppingObject::~ConeSteppingObject() {
+	glDeleteBuffers(1, &ebo);
+	glDeleteBuffers(1, &shell_vbo);
 	glDeleteBuffers(1, &vbo);
 	glDeleteVertexArrays(1, &vao);
 }
-
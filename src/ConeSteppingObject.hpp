@@ -10,21 +10,37 @@
 // STD
 #include <vector>
 
-// vertex structure
-struct PosUVVertex {
-	glm::vec3 pos;
-	glm::vec2 uv;
-};
+#include "Mesh.hpp"
 
 // object structure
 struct ConeSteppingObject {
 	GLuint vao;
 	GLuint vbo;
+	GLuint ebo;
+	GLuint shell_vbo; // heights of the vertices within the shell
+	GLsizei index_count;
+	glm::vec4 uv_transform; // the vertices store uvs relative to the bounds, offset in xy and scale in zw
 	GLuint stepmapTex;
 	GLuint texmapTex;
 	float depth = 0.25f;
 
+	// bounds of the undisplaced mesh in object space
+	glm::vec3 bounds_min;
+	glm::vec3 bounds_max;
+	float uv_to_world; // object space length of a unit in uv space, averaged over the mesh
+
+	// The height field volume below the mesh is closed by side walls extruded along the open boundary,
+	// so rays entering at grazing angles start inside the volume.
+	// If the boundary runs along the uv bounds, rays leaving the bounds leave the volume.
+	bool boundary_on_uv_bounds;
+
+	// cone containing all face normals, for culling objects facing away as a whole
+	glm::vec3 normal_cone_axis;
+	float normal_cone_cutoff; // sine of the largest angle to the axis, 1 if the faces can never all face away
+
+	// unindexed triangles, identical vertices are welded
 	ConeSteppingObject(const std::vector<PosUVVertex> vertices);
+	ConeSteppingObject(const Mesh &mesh);
 	~ConeSteppingObject();
 };
 
@@ -27,6 +27,9 @@ public:
 	void set_aspect(float aspect) { camera.set_aspect(aspect); }
 	void move(double delta_time);
 
+	// true while a movement key is held, the camera changes every frame
+	bool is_moving() const { return w_down || a_down || s_down || d_down || q_down || e_down; }
+
 	void keyboard_action(int key, int scancode, int action, int mods);
 	void mouse_button_action(int button, int action, int mods);
 	void mouse_move_action(double xpos, double ypos);
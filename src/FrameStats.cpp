@@ -0,0 +1,71 @@
+// STD
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "FrameStats.hpp"
+
+void FrameStats::add(double frame_time) {
+	if (count == capacity) {
+		sum -= times[next];
+	} else {
+		count++;
+	}
+	times[next] = frame_time;
+	sum += frame_time;
+	next = (next + 1) % capacity;
+}
+
+FrameStats::Summary FrameStats::summary() const {
+	Summary s;
+	s.count = count;
+	if (count == 0) return s;
+
+	sorted.assign(times.begin(), times.begin() + count); // the order does not matter here
+	std::sort(sorted.begin(), sorted.end());
+
+	// nearest rank
+	auto percentile = [&](double p) {
+		const size_t rank = static_cast<size_t>(std::ceil(p * count));
+		return sorted[std::clamp<size_t>(rank, 1, count) - 1];
+	};
+
+	s.min = sorted.front();
+	s.max = sorted.back();
+	s.avg = sum / count;
+	s.p50 = percentile(0.50);
+	s.p95 = percentile(0.95);
+	s.p99 = percentile(0.99);
+	return s;
+}
+
+bool FrameStats::write_csv(const std::filesystem::path &path) const {
+	std::ofstream file(path);
+	if (!file.is_open()) return false;
+
+	file << "frame,milliseconds\n";
+	for (size_t i = 0; i < count; i++) {
+		file << i << "," << milliseconds(i) << "\n";
+	}
+	return file.good();
+}
+
+bool FrameStats::write_json(const std::filesystem::path &path) const {
+	std::ofstream file(path);
+	if (!file.is_open()) return false;
+
+	const Summary s = summary();
+	file << "{\"count\":" << s.count
+		<< ",\"min_ms\":" << s.min * 1e3
+		<< ",\"avg_ms\":" << s.avg * 1e3
+		<< ",\"p50_ms\":" << s.p50 * 1e3
+		<< ",\"p95_ms\":" << s.p95 * 1e3
+		<< ",\"p99_ms\":" << s.p99 * 1e3
+		<< ",\"max_ms\":" << s.max * 1e3
+		<< ",\"frames_ms\":[";
+	for (size_t i = 0; i < count; i++) {
+		file << (i ? "," : "") << milliseconds(i);
+	}
+	file << "]}\n";
+	return file.good();
+}
@@ -0,0 +1,52 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+// STD
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+// Times of the last frames in a fixed ring buffer, nothing is allocated per frame.
+// Percentiles show stutter that an average frame rate hides.
+class FrameStats {
+public:
+	static constexpr size_t capacity = 1024;
+
+	struct Summary {
+		size_t count = 0;
+		double min = 0.0; // seconds
+		double avg = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	FrameStats() { sorted.reserve(capacity); }
+
+	// adds the duration of a frame in seconds, replacing the oldest once full
+	void add(double frame_time);
+
+	size_t size() const { return count; }
+
+	// i-th frame time in milliseconds, oldest first
+	float milliseconds(size_t i) const { return static_cast<float>(times[(next + capacity - count + i) % capacity] * 1e3); }
+
+	// statistics of the frames in the buffer
+	Summary summary() const;
+
+	// frame times in milliseconds, oldest first, returns false if the file cannot be written
+	bool write_csv(const std::filesystem::path &path) const;
+	bool write_json(const std::filesystem::path &path) const; // with the summary
+
+private:
+	std::array<double, capacity> times{};
+	size_t next = 0; // index the next frame is written to
+	size_t count = 0;
+	double sum = 0.0; // of the frames in the buffer
+
+	mutable std::vector<double> sorted; // scratch space for the percentiles
+};
+
+#endif
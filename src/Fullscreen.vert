@@ -0,0 +1,10 @@
+#version 330 core
+
+// outputs to fragment shader
+out vec2 screenUV;
+
+void main() {
+	// one triangle covering the screen, vertices 0, 1, 2 at (0, 0), (2, 0), (0, 2) in uv
+	screenUV = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(screenUV * 2.0f - 1.0f, 0.0f, 1.0f);
+}
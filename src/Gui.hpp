@@ -3,8 +3,12 @@
 
 // STD
 #include <algorithm>
+#include <cfloat>
+#include <ctime>
 #include <filesystem>
+#include <set>
 #include <string>
+#include <unordered_map>
 
 // ImGui
 #include "imgui.h"
@@ -14,11 +18,16 @@
 #include "file_utils.hpp"
 #include "ConeSteppingObject.hpp"
 #include "ConeMapGenerator.hpp"
+#include "FrameStats.hpp"
+#include "Scene.hpp"
+#include "ThumbnailCache.hpp"
 
 struct TextureResource {
 	std::filesystem::path path;
 	std::string name;
 	GLuint id = 0;
+	std::optional<uintmax_t> file_size; // unknown while a generated file is being written
+	std::optional<uint64_t> content_hash; // only computed once another file of the same size is loaded
 };
 
 struct TextureResourceSelect {
@@ -29,6 +38,19 @@ struct TextureResourceSelect {
 	int selected_index = -1;
 	GLuint &selected_id;
 
+	ThumbnailCache &thumbnails;
+
+	// indices of loaded resources by file identity and by file size, for finding identical files
+	std::unordered_map<FileKey, size_t, FileKeyHash> resources_by_file;
+	std::unordered_multimap<uintmax_t, size_t> resources_by_size;
+	// generated files that were complete before their texture was added
+	std::set<std::filesystem::path> written_before_loading;
+
+	// indices of resources passing the filter, only recomputed when the filter or the resources change
+	ImGuiTextFilter filter;
+	std::vector<size_t> filtered;
+	bool filtered_dirty = true;
+
 	ImGui::FileBrowser file_selector = ImGui::FileBrowser(
 			ImGuiFileBrowserFlags_MultipleSelection |
 			ImGuiFileBrowserFlags_ConfirmOnEnter |
@@ -37,14 +59,14 @@ struct TextureResourceSelect {
 
 	bool require_conemap;
 
-	TextureResourceSelect(const std::string &label_, GLuint &selected_id_, bool require_conemap_ = false)
-			: label(label_), selected_id(selected_id_), require_conemap(require_conemap_) {
+	TextureResourceSelect(const std::string &label_, GLuint &selected_id_, ThumbnailCache &thumbnails_, bool require_conemap_ = false)
+			: label(label_), selected_id(selected_id_), thumbnails(thumbnails_), require_conemap(require_conemap_) {
 				file_selector.SetTypeFilters({".png", ".jpg", ".jpeg"});
 				file_selector.SetTitle(label + " selection");
 			}
 
-	TextureResourceSelect(const std::string &label_, GLuint &selected_id_, const std::vector<std::filesystem::path> &paths, bool require_conemap_ = false)
-			: TextureResourceSelect(label_, selected_id_, require_conemap_) {
+	TextureResourceSelect(const std::string &label_, GLuint &selected_id_, ThumbnailCache &thumbnails_, const std::vector<std::filesystem::path> &paths, bool require_conemap_ = false)
+			: TextureResourceSelect(label_, selected_id_, thumbnails_, require_conemap_) {
 				load_files(paths);
 				
 				// select the last file loaded
@@ -60,21 +82,51 @@ struct TextureResourceSelect {
 		}
 	}
 
+	// the loaded resource with the same contents as the file
+	// only files of the same size are read, their hashes narrow them down before comparing byte for byte
+	std::optional<size_t> find_identical(const std::filesystem::path &path, uintmax_t size) {
+		auto [begin, end] = resources_by_size.equal_range(size);
+		if (begin == end) return std::nullopt;
+
+		std::optional<uint64_t> hash = hash_file_contents(path);
+		if (!hash) return std::nullopt;
+
+		for (auto it = begin; it != end; ++it) {
+			TextureResource &resource = resources[it->second];
+			if (!resource.content_hash) resource.content_hash = hash_file_contents(resource.path);
+			if (resource.content_hash == hash && files_equal(path, resource.path)) return it->second;
+		}
+		return std::nullopt;
+	}
+
 	bool load_files(const std::vector<std::filesystem::path> &paths) {
 		error = ""; // remove error messages before attempting to load new textures
 
 		bool success = false;
 		for (std::filesystem::path path : paths) {
-			auto it = std::find_if(resources.begin(), resources.end(),
-													 	 [&path](const TextureResource &res) {
-														 	 return std::filesystem::equivalent(res.path, path);
-													 	 });
+			std::optional<FileKey> key = get_file_key(path);
+			if (!key) {
+				error += path.string() + " could not be loaded.\n";
+				continue;
+			}
 
-			if (it != resources.end()) {
+			if (resources_by_file.contains(*key)) {
 				error += path.string() + " is already loaded.\n";
 				continue;
 			}
 
+			std::error_code ec;
+			const uintmax_t size = std::filesystem::file_size(path, ec);
+			if (ec) {
+				error += path.string() + " could not be loaded.\n";
+				continue;
+			}
+
+			if (std::optional<size_t> identical = find_identical(path, size)) {
+				error += path.string() + " is identical to " + resources[*identical].path.string() + ", which is already loaded.\n";
+				continue;
+			}
+
 			GLuint id = load_texture_from_file(path, require_conemap);
 			
 			if(!id) {
@@ -82,7 +134,10 @@ struct TextureResourceSelect {
 				continue;
 			}
 
-			resources.push_back(TextureResource{path, path.filename(), id});
+			resources_by_file.emplace(*key, resources.size());
+			resources_by_size.emplace(size, resources.size());
+			resources.push_back(TextureResource{path, path.filename(), id, size, std::nullopt});
+			filtered_dirty = true;
 
 			success = true;
 		}
@@ -90,6 +145,58 @@ struct TextureResourceSelect {
 		return success;
 	}
 
+	// adds a texture decoded elsewhere
+	// if the file is not written yet, it is indexed for duplicate detection by file_written once it is
+	bool load_pixels(const std::filesystem::path &path, const unsigned char *pixels, int width, int height, bool written) {
+		error = "";
+
+		std::optional<FileKey> key;
+		std::optional<uintmax_t> size;
+		if (written || written_before_loading.erase(path)) {
+			key = get_file_key(path);
+			std::error_code ec;
+			size = std::filesystem::file_size(path, ec);
+			if (ec) size.reset();
+		}
+
+		if (key && resources_by_file.contains(*key)) {
+			error += path.string() + " is already loaded.\n";
+			return false;
+		}
+
+		GLuint id = create_texture(pixels, width, height, require_conemap);
+		if (!id) {
+			error += path.string() + " could not be loaded.\n";
+			return false;
+		}
+
+		if (key) resources_by_file.emplace(*key, resources.size());
+		if (size) resources_by_size.emplace(*size, resources.size());
+		resources.push_back(TextureResource{path, path.filename(), id, size, std::nullopt});
+		filtered_dirty = true;
+
+		return true;
+	}
+
+	// indexes a texture added by load_pixels before its file was complete
+	void file_written(const std::filesystem::path &path) {
+		for (size_t i = 0; i < resources.size(); i++) {
+			TextureResource &resource = resources[i];
+			if (resource.path != path || resource.file_size) continue;
+
+			std::optional<FileKey> key = get_file_key(path);
+			std::error_code ec;
+			const uintmax_t size = std::filesystem::file_size(path, ec);
+			if (!key || ec) return;
+
+			resources_by_file.emplace(*key, i);
+			resources_by_size.emplace(size, i);
+			resource.file_size = size;
+			return;
+		}
+		written_before_loading.insert(path);
+	}
+
 	void file_combo() {
 		const char *combo_preview_value =
 				selected_index >= 0 // selected_index < resources.size() // if there is a selected resource
@@ -97,30 +204,55 @@ struct TextureResourceSelect {
 						: "";
 
 		if (ImGui::BeginCombo(label.c_str(), combo_preview_value)) {
-			static ImGuiTextFilter filter;
 			if (ImGui::IsWindowAppearing()) {
 				ImGui::SetKeyboardFocusHere();
 				filter.Clear();
+				filtered_dirty = true;
 			}
 			ImGui::SetNextItemShortcut(ImGuiMod_Ctrl | ImGuiKey_F);
-			filter.Draw("##Filter", -FLT_MIN);
+			if (filter.Draw("##Filter", -FLT_MIN)) {
+				filtered_dirty = true;
+			}
+
+			if (filtered_dirty) {
+				filtered.clear();
+				for (size_t i = 0; i < resources.size(); i++) {
+					if (filter.PassFilter(resources[i].name.c_str())) { // only display names that match the filer string
+						filtered.push_back(i);
+					}
+				}
+				filtered_dirty = false;
+			}
 
-			for (size_t i = 0; i < resources.size(); i++) {
-				const bool is_selected = (static_cast<size_t>(selected_index) == i);
+			// only emit the visible entries
+			ImGuiListClipper clipper;
+			clipper.Begin(filtered.size());
+			while (clipper.Step()) {
+				for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+					const size_t i = filtered[row];
+					const bool is_selected = (static_cast<size_t>(selected_index) == i);
+
+					// preview, generated in the background when first shown
+					const float preview_size = 2.0f * ImGui::GetTextLineHeightWithSpacing();
+					if (auto thumbnail = thumbnails.get(resources[i].path, require_conemap)) {
+						ImGui::Image(thumbnail->texture, ImVec2(preview_size, preview_size), thumbnail->uv0, thumbnail->uv1);
+					} else {
+						ImGui::Dummy(ImVec2(preview_size, preview_size));
+					}
+					ImGui::SameLine();
 
-				if (filter.PassFilter(resources[i].name.c_str())) { // only display names that match the filer string
 					ImGui::PushID(resources[i].id); // needed for resources with the same name
-					if (ImGui::Selectable(resources[i].name.c_str(), is_selected)) {
+					if (ImGui::Selectable(resources[i].name.c_str(), is_selected, 0, ImVec2(0.0f, preview_size))) {
 						// set selected
 						selected_index = i;
 						selected_id = resources[selected_index].id;
 						error = ""; // remove error when selecting new texture
 					}
 					ImGui::PopID();
-				}
 
-				if (ImGui::IsItemHovered())
-					ImGui::SetTooltip("%s", resources[i].path.c_str());
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("%s", resources[i].path.c_str());
+				}
 			}
 			ImGui::EndCombo();
 		}
@@ -160,19 +292,68 @@ class Gui {
 	int &display_mode;
 	bool &cell_max_trace;
 	bool &show_convergence;
+	bool &footprint_lod;
+	bool &silhouettes;
+	bool &use_bindless;
+	bool bindless_supported;
+	bool &use_compute;
+	bool compute_supported;
+	bool &culling;
+	bool &depth_prepass;
+	const size_t &visible_instances;
+	ResolutionScaler &resolution;
 
 	// object settings
 	ConeSteppingObject &object;
+	ThumbnailCache thumbnails; // shared by the selects below
 	TextureResourceSelect cone_maps;
 	TextureResourceSelect textures;
 	float &depth;
 
+	// instances
+	InstanceSet &instances;
+	int grid_size = 1;
+	bool cycle_maps = false; // assign the loaded cone maps and textures to the instances in turn
+
+	void update_instances() {
+		instances.instances = grid_instances(grid_size);
+		if (cycle_maps) {
+			for (size_t i = 0; i < instances.instances.size(); i++) {
+				Instance &instance = instances.instances[i];
+				if (!cone_maps.resources.empty()) instance.stepmap = cone_maps.resources[i % cone_maps.resources.size()].id;
+				if (!textures.resources.empty()) instance.texmap = textures.resources[i % textures.resources.size()].id;
+			}
+		}
+		instances.changed = true;
+	}
+
 	// cone map generation
 	ConeMapGenerator cone_map_generator;
 
+	// result of the last frame time export
+	std::string frame_stats_message;
+
+	void export_frame_stats(const FrameStats &frame_stats, bool json) {
+		const std::filesystem::path directory = state_directory();
+		std::error_code ec;
+		if (!directory.empty()) std::filesystem::create_directories(directory, ec);
+		if (directory.empty() || ec) {
+			frame_stats_message = "Error: No directory to export to.";
+			return;
+		}
+
+		const std::filesystem::path path = directory / ("frame_times_" + std::to_string(std::time(nullptr)) + (json ? ".json" : ".csv"));
+		const bool written = json ? frame_stats.write_json(path) : frame_stats.write_csv(path);
+		frame_stats_message = written ? "Exported to " + path.string() : "Error: Could not write " + path.string();
+	}
+
 public:
-	Gui(int &cone_steps_, int &binary_steps_, int &display_mode_, bool &cell_max_trace_, bool &show_convergence_,
-			ConeSteppingObject &object_, 
+	// render continuously instead of only when something changed
+	bool unlimited_frame_rate = false;
+
+	Gui(int &cone_steps_, int &binary_steps_, int &display_mode_, bool &cell_max_trace_, bool &show_convergence_, bool &footprint_lod_, bool &silhouettes_,
+			bool &use_bindless_, bool bindless_supported_, bool &use_compute_, bool compute_supported_, bool &culling_, bool &depth_prepass_, const size_t &visible_instances_,
+			ResolutionScaler &resolution_, ConeSteppingObject &object_, InstanceSet &instances_,
 			std::vector<std::filesystem::path> &input_cone_maps,
 			std::vector<std::filesystem::path> &input_textures) :
 				cone_steps(cone_steps_),
@@ -180,18 +361,58 @@ public:
 				display_mode(display_mode_),
 				cell_max_trace(cell_max_trace_),
 				show_convergence(show_convergence_),
+				footprint_lod(footprint_lod_),
+				silhouettes(silhouettes_),
+				use_bindless(use_bindless_),
+				bindless_supported(bindless_supported_),
+				use_compute(use_compute_),
+				compute_supported(compute_supported_),
+				culling(culling_),
+				depth_prepass(depth_prepass_),
+				visible_instances(visible_instances_),
+				resolution(resolution_),
 				object(object_),
-				cone_maps(TextureResourceSelect("Cone map", object.stepmapTex, input_cone_maps, true)),
-				textures(TextureResourceSelect("Texture", object.texmapTex, input_textures)),
+				cone_maps(TextureResourceSelect("Cone map", object.stepmapTex, thumbnails, input_cone_maps, true)),
+				textures(TextureResourceSelect("Texture", object.texmapTex, thumbnails, input_textures)),
 				depth(object.depth),
+				instances(instances_),
 				cone_map_generator(ConeMapGenerator()) {}
 
-	void compose(double fps) {
+	// cone map generation requested on the command line
+	void generate_cone_maps(const std::vector<std::filesystem::path> &inputs, bool analytic, bool depthmap, bool wrap) {
+		cone_map_generator.generate(inputs, analytic, depthmap, wrap);
+	}
+
+	// true while background work shows progress or delivers results, so frames have to keep coming
+	bool busy() const {
+		return cone_map_generator.busy() || thumbnails.busy();
+	}
+
+	// grid of instances requested on the command line
+	void set_grid_size(int size) {
+		grid_size = std::max(1, size);
+		update_instances();
+	}
+
+	void compose(const FrameStats &frame_stats) {
+		// upload previews finished since the last frame
+		thumbnails.update();
+
+		// index generated cone maps whose files are complete now
+		while (std::optional<std::filesystem::path> written = cone_map_generator.written()) {
+			cone_maps.file_written(*written);
+		}
+
 		// Cone map generation
 		if (ImGui::Begin("Cone map generation")) {
-			std::filesystem::path new_cone_map = cone_map_generator.compose();
-			if (!new_cone_map.empty()) {
-				cone_maps.load_files({new_cone_map});
+			std::optional<GeneratedConeMap> new_cone_map = cone_map_generator.compose();
+			if (new_cone_map) {
+				if (new_cone_map->pixels) {
+					// upload directly, the file may still be being written
+					cone_maps.load_pixels(new_cone_map->path, new_cone_map->pixels->data(), new_cone_map->width, new_cone_map->height, new_cone_map->written);
+				} else {
+					cone_maps.load_files({new_cone_map->path});
+				}
 			}
 		}
 		ImGui::End();
@@ -204,6 +425,8 @@ public:
 			ImGui::SliderInt("Binary search steps", &binary_steps, 0, 16);
 			ImGui::Checkbox("Cell-max tracing", &cell_max_trace);
 			ImGui::Checkbox("Show convergence", &show_convergence);
+			ImGui::Checkbox("Footprint LOD", &footprint_lod);
+			ImGui::Checkbox("Silhouettes", &silhouettes);
 
 			ImGui::RadioButton("Heights", &display_mode, 1);
 			ImGui::RadioButton("Cones", &display_mode, 2);
@@ -212,12 +435,60 @@ public:
 				ImGui::BeginDisabled(display_mode);
 					textures.file_combo(); // only active in Color texture display mode
 				ImGui::EndDisabled();
+
+			ImGui::SeparatorText("Instances");
+			bool instances_edited = ImGui::SliderInt("Grid size", &grid_size, 1, 128);
+			instances_edited |= ImGui::Checkbox("Cycle loaded maps", &cycle_maps);
+			if (cycle_maps) instances_edited |= ImGui::Button("Reassign maps"); // to include maps loaded since
+			if (instances_edited) update_instances();
+			ImGui::Checkbox("Culling", &culling);
+			ImGui::Checkbox("Depth prepass", &depth_prepass);
+			ImGui::Text("%zu of %zu instances visible", visible_instances, instances.instances.size());
+			ImGui::BeginDisabled(!bindless_supported);
+				ImGui::Checkbox(bindless_supported ? "Bindless textures" : "Bindless textures (not supported)", &use_bindless);
+			ImGui::EndDisabled();
+			ImGui::BeginDisabled(!compute_supported);
+				// steps the selected maps on all instances
+				ImGui::Checkbox(compute_supported ? "Compute tiles" : "Compute tiles (not supported)", &use_compute);
+			ImGui::EndDisabled();
+
+			ImGui::SeparatorText("Resolution");
+			ImGui::Checkbox("Dynamic resolution", &resolution.dynamic);
+			if (resolution.dynamic) {
+				ImGui::SliderFloat("Target GPU time", &resolution.target_milliseconds, 1.0f, 50.0f, "%.1f ms");
+				ImGui::SliderFloat("Minimum scale", &resolution.min_scale, 0.1f, 1.0f);
+			}
+			ImGui::BeginDisabled(resolution.dynamic);
+				ImGui::SliderFloat("Scale", &resolution.scale, resolution.min_scale, 1.0f); // set by dynamic resolution
+			ImGui::EndDisabled();
+			ImGui::Checkbox("Edge-aware upscaling", &resolution.edge_aware);
+			ImGui::Text("Traced pixels");
+			ImGui::RadioButton("All", &resolution.interleave, 1);
+			ImGui::SameLine();
+			ImGui::RadioButton("Checkerboard", &resolution.interleave, 2);
+			ImGui::SameLine();
+			ImGui::RadioButton("Quarter", &resolution.interleave, 4);
+			ImGui::Text("%dx%d, GPU %.2f ms", resolution.get_width(), resolution.get_height(), resolution.gpu_milliseconds);
 		}
 		ImGui::End();
 
-		// FPS counter
+		// Frame times
 		if (ImGui::Begin("FPS")) {
-			ImGui::LabelText("", "%f", fps);
+			const FrameStats::Summary summary = frame_stats.summary();
+			ImGui::Text("%.1f FPS over %zu frames", summary.avg > 0.0 ? 1.0 / summary.avg : 0.0, summary.count);
+			ImGui::Text("min %.2f  avg %.2f  max %.2f ms", summary.min * 1e3, summary.avg * 1e3, summary.max * 1e3);
+			ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f ms", summary.p50 * 1e3, summary.p95 * 1e3, summary.p99 * 1e3);
+			ImGui::PlotLines("##Frame times",
+					[](void *data, int i) { return static_cast<const FrameStats *>(data)->milliseconds(i); },
+					const_cast<FrameStats *>(&frame_stats), static_cast<int>(frame_stats.size()), 0,
+					"frame time (ms)", 0.0f, FLT_MAX, ImVec2(-FLT_MIN, 80.0f));
+
+			if (ImGui::Button("Export CSV")) export_frame_stats(frame_stats, false);
+			ImGui::SameLine();
+			if (ImGui::Button("Export JSON")) export_frame_stats(frame_stats, true);
+			if (!frame_stats_message.empty()) ImGui::TextWrapped("%s", frame_stats_message.c_str());
+
+			ImGui::Checkbox("Unlimited frame rate", &unlimited_frame_rate); // for benchmarking
 		}
 		ImGui::End();
 	}
@@ -0,0 +1,355 @@
+// GLM
+#include <glm/geometric.hpp>
+
+// STD
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Mesh.hpp"
+#include "parallel_for.hpp"
+
+Mesh Mesh::from_triangles(const std::vector<PosUVVertex> &triangles) {
+	using Key = std::array<float, 5>;
+	struct KeyHash {
+		size_t operator()(const Key &key) const {
+			// FNV-1a over the bytes, -0.0 and 0.0 just stay separate vertices
+			uint64_t hash = 0xcbf29ce484222325ull;
+			const unsigned char *bytes = reinterpret_cast<const unsigned char *>(key.data());
+			for (size_t i = 0; i < sizeof(Key); i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+			return hash;
+		}
+	};
+
+	Mesh mesh;
+	std::unordered_map<Key, uint32_t, KeyHash> ids;
+	mesh.indices.reserve(triangles.size());
+	for (const PosUVVertex &vertex : triangles) {
+		const Key key = {vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.uv.x, vertex.uv.y};
+		auto [it, inserted] = ids.emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+		if (inserted) mesh.vertices.push_back(vertex);
+		mesh.indices.push_back(it->second);
+	}
+	return mesh;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> Mesh::boundary_edges() const {
+	using Key = std::array<float, 3>;
+	struct KeyHash {
+		size_t operator()(const Key &key) const {
+			uint64_t hash = 0xcbf29ce484222325ull;
+			const unsigned char *bytes = reinterpret_cast<const unsigned char *>(key.data());
+			for (size_t i = 0; i < sizeof(Key); i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+			return hash;
+		}
+	};
+
+	// vertices identified by position only
+	std::unordered_map<Key, uint32_t, KeyHash> ids;
+	std::vector<uint32_t> position_ids(vertices.size());
+	for (size_t v = 0; v < vertices.size(); v++) {
+		const glm::vec3 &pos = vertices[v].pos;
+		position_ids[v] = ids.emplace(Key{pos.x, pos.y, pos.z}, static_cast<uint32_t>(ids.size())).first->second;
+	}
+
+	auto directed = [&](uint32_t a, uint32_t b) { return uint64_t(position_ids[a]) << 32 | position_ids[b]; };
+	std::unordered_set<uint64_t> edges;
+	for (size_t i = 0; i < indices.size(); i++) {
+		edges.insert(directed(indices[i], indices[i % 3 == 2 ? i - 2 : i + 1]));
+	}
+
+	// an edge is open if no triangle runs along it the other way
+	std::vector<std::pair<uint32_t, uint32_t>> boundary;
+	for (size_t i = 0; i < indices.size(); i++) {
+		const uint32_t a = indices[i];
+		const uint32_t b = indices[i % 3 == 2 ? i - 2 : i + 1];
+		if (!edges.contains(directed(b, a))) boundary.emplace_back(a, b);
+	}
+	return boundary;
+}
+
+void Mesh::fit_to_quad() {
+	if (vertices.empty()) return;
+
+	glm::vec3 lower(std::numeric_limits<float>::max());
+	glm::vec3 upper(std::numeric_limits<float>::lowest());
+	for (const PosUVVertex &vertex : vertices) {
+		lower = glm::min(lower, vertex.pos);
+		upper = glm::max(upper, vertex.pos);
+	}
+
+	const glm::vec3 center = 0.5f * (lower + upper);
+	const glm::vec3 extent = upper - lower;
+	const float size = std::max({extent.x, extent.y, extent.z});
+	const float scale = size > 0.0f ? 2.0f / size : 1.0f;
+	for (PosUVVertex &vertex : vertices) {
+		vertex.pos = (vertex.pos - center) * scale;
+	}
+}
+
+Mesh::TangentFrames Mesh::tangent_frames(bool parallel) const {
+	const size_t vertex_count = vertices.size();
+	const size_t triangle_count = indices.size() / 3;
+
+	// faces and vertices are independent of each other, so they are split into chunks for the worker pool
+	auto for_chunks = [parallel](size_t count, const auto &body) {
+		if (parallel) {
+			parallel_for(count, 4096, body);
+		} else {
+			body(0, count);
+		}
+	};
+
+	TangentFrames frames;
+
+	// directions of each triangle
+	struct FaceFrame {
+		glm::vec3 normal;
+		glm::vec3 tangent;
+		glm::vec3 bitangent;
+	};
+	std::vector<FaceFrame> faces(triangle_count);
+
+	// find the tangent and bitangent and normal for each triangle face
+	for_chunks(triangle_count, [&](size_t begin, size_t end) {
+		for (size_t f = begin; f < end; f++) {
+			const uint32_t i0 = indices[3 * f];
+			const uint32_t i1 = indices[3 * f + 1];
+			const uint32_t i2 = indices[3 * f + 2];
+
+			glm::vec3 dp1 = vertices[i1].pos - vertices[i0].pos;
+			glm::vec3 dp2 = vertices[i2].pos - vertices[i0].pos;
+			glm::vec2 duv1 = vertices[i1].uv - vertices[i0].uv;
+			glm::vec2 duv2 = vertices[i2].uv - vertices[i0].uv;
+
+			// the face normal follows the winding, its length weights the face by its area
+			faces[f].normal = glm::cross(dp1, dp2);
+
+			// duv1 and duv2 form a base in the uv plane
+			// we are looking for the inverse, which transforms these vectors to u and v
+
+			// we multiply the corresponding dp1 and dp2 with the inverse to get the
+			// 3D object space direction vectors corresponding to u and v
+
+			const float uv_area = duv1.x * duv2.y - duv1.y * duv2.x;
+			if (std::abs(uv_area) < 1e-12f) { // no texture mapping to follow
+				faces[f].tangent = faces[f].bitangent = glm::vec3(0.0f);
+				continue;
+			}
+
+			float det = 1.0f / uv_area;
+
+			faces[f].tangent = det * (dp1 * duv2.y - dp2 * duv1.y);
+			faces[f].bitangent = det * (dp2 * duv1.x - dp1 * duv2.x); // z faces the other way
+		}
+	});
+
+	// triangles around each vertex (compressed rows), so every vertex sums its own faces without locking
+	std::vector<uint32_t> face_offsets(vertex_count + 1, 0);
+	for (uint32_t index : indices) face_offsets[index + 1]++;
+	for (size_t v = 0; v < vertex_count; v++) face_offsets[v + 1] += face_offsets[v];
+	std::vector<uint32_t> vertex_faces(3 * triangle_count);
+	{
+		std::vector<uint32_t> fill(face_offsets.begin(), face_offsets.end() - 1);
+		for (size_t i = 0; i < 3 * triangle_count; i++) vertex_faces[fill[indices[i]]++] = i / 3;
+	}
+
+	// orthonormal frame per vertex
+	frames.vertex_frames.resize(vertex_count);
+	for_chunks(vertex_count, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			glm::vec3 face_normal(0.0f);
+			glm::vec3 face_tangent(0.0f);
+			glm::vec3 face_bitangent(0.0f);
+			for (uint32_t i = face_offsets[v]; i < face_offsets[v + 1]; i++) {
+				const FaceFrame &face = faces[vertex_faces[i]];
+				face_normal += face.normal;
+				face_tangent += face.tangent;
+				face_bitangent += face.bitangent;
+			}
+
+			glm::vec3 normal = normals.empty() ? face_normal : normals[v];
+			if (glm::length(normal) < 1e-20f) normal = glm::cross(face_tangent, face_bitangent);
+			normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+			// Gram-Schmidt, any perpendicular direction if the texture mapping does not give one
+			glm::vec3 tangent = face_tangent - normal * glm::dot(normal, face_tangent);
+			if (glm::length(tangent) < 1e-20f) {
+				tangent = glm::cross(std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f), normal);
+			}
+			tangent = glm::normalize(tangent);
+
+			// the normal is the cross product of tangent and bitangent, unless the texture is mirrored
+			const bool mirrored = glm::dot(glm::cross(normal, tangent), face_bitangent) < 0.0f;
+
+			// rotation of the unmirrored frame
+			glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(tangent, glm::cross(normal, tangent), normal)));
+
+			// q and -q are the same rotation, so the sign of w is free to store the handedness
+			// but w must not quantize to 0 where it has no sign
+			if (q.w < 0.0f) q = -q;
+			const float bias = 1.0f / 32767.0f;
+			if (q.w < bias) {
+				const float xyz_scale = std::sqrt(1.0f - bias * bias) / std::max(glm::length(glm::vec3(q.x, q.y, q.z)), 1e-20f);
+				q = glm::quat(bias, q.x * xyz_scale, q.y * xyz_scale, q.z * xyz_scale);
+			}
+			if (mirrored) q = -q;
+
+			frames.vertex_frames[v] = q;
+		}
+	});
+
+	frames.face_normals.resize(triangle_count);
+	for (size_t f = 0; f < triangle_count; f++) frames.face_normals[f] = faces[f].normal;
+	return frames;
+}
+
+// position, uv and normal indices of a face vertex, -1 if missing
+struct ObjIndex {
+	int v;
+	int vt;
+	int vn;
+
+	bool operator==(const ObjIndex &) const = default;
+};
+
+struct ObjIndexHash {
+	size_t operator()(const ObjIndex &i) const {
+		return (static_cast<size_t>(i.v) * 73856093) ^ (static_cast<size_t>(i.vt) * 19349663) ^ (static_cast<size_t>(i.vn) * 83492791);
+	}
+};
+
+// parses up to count floats, returns the number parsed
+static int parse_floats(const char *s, float *values, int count) {
+	int parsed = 0;
+	for (; parsed < count; parsed++) {
+		char *end;
+		values[parsed] = std::strtof(s, &end);
+		if (end == s) break;
+		s = end;
+	}
+	return parsed;
+}
+
+// resolves a 1-based or negative (relative to the end) OBJ index, -1 if it is out of range
+static int resolve_index(long index, size_t count) {
+	if (index > 0 && static_cast<size_t>(index) <= count) return static_cast<int>(index - 1);
+	if (index < 0 && static_cast<size_t>(-index) <= count) return static_cast<int>(count + index);
+	return -1;
+}
+
+std::optional<Mesh> load_obj(const std::filesystem::path &path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::fprintf(stderr, "Error: Could not open %s\n", path.c_str());
+		return std::nullopt;
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+
+	Mesh mesh;
+	std::vector<glm::vec3> vertex_normals;
+	bool all_normals = true; // normals are only used if every vertex has one
+	std::unordered_map<ObjIndex, uint32_t, ObjIndexHash> ids;
+	std::vector<uint32_t> polygon;
+
+	std::string line;
+	int line_number = 0;
+	while (std::getline(file, line)) {
+		line_number++;
+		const char *s = line.c_str();
+		while (std::isspace(static_cast<unsigned char>(*s))) s++;
+
+		auto statement = [&s](const char *name) {
+			const size_t length = std::strlen(name);
+			if (std::strncmp(s, name, length) != 0 || !std::isspace(static_cast<unsigned char>(s[length]))) return false;
+			s += length;
+			return true;
+		};
+
+		if (statement("v")) {
+			glm::vec3 p;
+			if (parse_floats(s, &p.x, 3) != 3) {
+				std::fprintf(stderr, "Error: %s:%d: Invalid vertex position.\n", path.c_str(), line_number);
+				return std::nullopt;
+			}
+			positions.push_back(p);
+		} else if (statement("vt")) {
+			glm::vec2 uv(0.0f);
+			if (parse_floats(s, &uv.x, 2) < 1) {
+				std::fprintf(stderr, "Error: %s:%d: Invalid texture coordinate.\n", path.c_str(), line_number);
+				return std::nullopt;
+			}
+			uvs.push_back(uv);
+		} else if (statement("vn")) {
+			glm::vec3 n;
+			if (parse_floats(s, &n.x, 3) != 3) {
+				std::fprintf(stderr, "Error: %s:%d: Invalid normal.\n", path.c_str(), line_number);
+				return std::nullopt;
+			}
+			normals.push_back(n);
+		} else if (statement("f")) {
+			// v, v/vt, v//vn or v/vt/vn
+			polygon.clear();
+			while (true) {
+				while (std::isspace(static_cast<unsigned char>(*s))) s++;
+				if (!*s) break;
+
+				char *end;
+				ObjIndex index = {resolve_index(std::strtol(s, &end, 10), positions.size()), -1, -1};
+				bool valid = end != s && index.v >= 0;
+				s = end;
+				if (valid && *s == '/') {
+					s++;
+					if (*s != '/') {
+						index.vt = resolve_index(std::strtol(s, &end, 10), uvs.size());
+						valid = end != s && index.vt >= 0;
+						s = end;
+					}
+					if (valid && *s == '/') {
+						s++;
+						index.vn = resolve_index(std::strtol(s, &end, 10), normals.size());
+						valid = end != s && index.vn >= 0;
+						s = end;
+					}
+				}
+				if (!valid || (*s && !std::isspace(static_cast<unsigned char>(*s)))) {
+					std::fprintf(stderr, "Error: %s:%d: Invalid face.\n", path.c_str(), line_number);
+					return std::nullopt;
+				}
+
+				auto [it, inserted] = ids.emplace(index, static_cast<uint32_t>(mesh.vertices.size()));
+				if (inserted) {
+					mesh.vertices.push_back(PosUVVertex{positions[index.v], index.vt >= 0 ? uvs[index.vt] : glm::vec2(0.0f)});
+					vertex_normals.push_back(index.vn >= 0 ? normals[index.vn] : glm::vec3(0.0f));
+					all_normals = all_normals && index.vn >= 0;
+				}
+				polygon.push_back(it->second);
+			}
+
+			for (size_t i = 2; i < polygon.size(); i++) {
+				mesh.indices.insert(mesh.indices.end(), {polygon[0], polygon[i - 1], polygon[i]});
+			}
+		}
+	}
+
+	if (mesh.indices.empty()) {
+		std::fprintf(stderr, "Error: %s has no faces.\n", path.c_str());
+		return std::nullopt;
+	}
+
+	if (all_normals) mesh.normals = std::move(vertex_normals);
+
+	return mesh;
+}
@@ -0,0 +1,50 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// STD
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// vertex structure
+struct PosUVVertex {
+	glm::vec3 pos;
+	glm::vec2 uv;
+};
+
+// indexed triangle mesh, every vertex is a unique combination of position, uv and normal
+struct Mesh {
+	std::vector<PosUVVertex> vertices;
+	std::vector<glm::vec3> normals; // one per vertex, empty to derive them from the triangles
+	std::vector<uint32_t> indices; // three per triangle, counterclockwise
+
+	// merges the identical vertices of a triangle list
+	static Mesh from_triangles(const std::vector<PosUVVertex> &triangles);
+
+	// edges of the open boundary as vertex index pairs in the winding of their triangle
+	// edges shared by position, as at uv seams, are not part of the boundary
+	std::vector<std::pair<uint32_t, uint32_t>> boundary_edges() const;
+
+	// tangent frames for displacement along the normal with the texture mapping
+	struct TangentFrames {
+		std::vector<glm::vec3> face_normals; // one per triangle, its length is twice the area
+		std::vector<glm::quat> vertex_frames; // rotation of (tangent, bitangent, normal), w < 0 if the bitangent is mirrored
+	};
+	// the frames are averaged over the triangles around each vertex, parallel spreads them over the worker pool
+	TangentFrames tangent_frames(bool parallel = true) const;
+
+	// centers the mesh at the origin and scales its largest extent to 2, the size of the default quad
+	void fit_to_quad();
+};
+
+// Loads the v, vt, vn and f statements of a Wavefront OBJ file, other statements are ignored.
+// Polygons are triangulated as fans.
+std::optional<Mesh> load_obj(const std::filesystem::path &path);
+
+#endif
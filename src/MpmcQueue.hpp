@@ -0,0 +1,150 @@
+#ifndef MPMC_QUEUE_HPP
+#define MPMC_QUEUE_HPP
+
+// STD
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stop_token>
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov's ring of sequenced cells).
+// try_push and try_pop never block or take a lock, so they are safe to call from the render thread.
+// push and pop block with atomic wait/notify until there is room or an element, or until stop is requested.
+template <typename T>
+class MpmcQueue {
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	static constexpr size_t cache_line = 64;
+
+	std::unique_ptr<Cell[]> cells;
+	const size_t mask;
+
+	alignas(cache_line) std::atomic<size_t> enqueue_pos = 0;
+	alignas(cache_line) std::atomic<size_t> dequeue_pos = 0;
+
+	// incremented on every push and pop, blocked consumers and producers wait for them to change
+	// (notify_all does not enter the kernel when nobody waits)
+	alignas(cache_line) std::atomic<uint32_t> pushes = 0;
+	alignas(cache_line) std::atomic<uint32_t> pops = 0;
+
+	static size_t round_up_to_power_of_two(size_t n) {
+		size_t p = 2;
+		while (p < n) p <<= 1;
+		return p;
+	}
+
+	// moves v into the queue only if there is room
+	bool try_push_from(T &v) {
+		size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+		Cell *cell;
+		while (true) {
+			cell = &cells[pos & mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+			if (diff == 0) {
+				// the cell is free, claim it
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				return false; // full
+			} else {
+				pos = enqueue_pos.load(std::memory_order_relaxed); // another producer claimed it
+			}
+		}
+
+		cell->value = std::move(v);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+
+		pushes.fetch_add(1, std::memory_order_release);
+		pushes.notify_all();
+		return true;
+	}
+
+public:
+	explicit MpmcQueue(size_t capacity)
+			: cells(new Cell[round_up_to_power_of_two(capacity)]), mask(round_up_to_power_of_two(capacity) - 1) {
+		for (size_t i = 0; i <= mask; i++) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpmcQueue(const MpmcQueue &) = delete;
+	MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+	size_t capacity() const { return mask + 1; }
+
+	// returns false if the queue is full
+	bool try_push(T v) {
+		return try_push_from(v);
+	}
+
+	// returns nullopt if the queue is empty
+	std::optional<T> try_pop() {
+		size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+		Cell *cell;
+		while (true) {
+			cell = &cells[pos & mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0) {
+				// the cell is filled, claim it
+				if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				return std::nullopt; // empty
+			} else {
+				pos = dequeue_pos.load(std::memory_order_relaxed); // another consumer claimed it
+			}
+		}
+
+		std::optional<T> v = std::move(cell->value);
+		cell->value = T(); // release resources held by the moved-from value
+		cell->sequence.store(pos + mask + 1, std::memory_order_release);
+
+		pops.fetch_add(1, std::memory_order_release);
+		pops.notify_all();
+		return v;
+	}
+
+	// blocks while the queue is full, returns false if stop was requested before the element was pushed
+	bool push(T v, std::stop_token stop = {}) {
+		std::stop_callback wake(stop, [this]() {
+			pops.fetch_add(1, std::memory_order_release);
+			pops.notify_all();
+		});
+
+		while (!stop.stop_requested()) {
+			const uint32_t seen = pops.load(std::memory_order_acquire);
+			if (try_push_from(v)) return true;
+			pops.wait(seen, std::memory_order_acquire);
+		}
+		return false;
+	}
+
+	// blocks while the queue is empty, returns nullopt if stop was requested before an element arrived
+	std::optional<T> pop(std::stop_token stop = {}) {
+		std::stop_callback wake(stop, [this]() {
+			pushes.fetch_add(1, std::memory_order_release);
+			pushes.notify_all();
+		});
+
+		while (!stop.stop_requested()) {
+			const uint32_t seen = pushes.load(std::memory_order_acquire);
+			if (std::optional<T> v = try_pop()) return v;
+			pushes.wait(seen, std::memory_order_acquire);
+		}
+		return std::nullopt;
+	}
+
+	// only a snapshot when other threads are pushing or popping
+	bool empty() const {
+		const size_t pos = dequeue_pos.load(std::memory_order_acquire);
+		return static_cast<intptr_t>(cells[pos & mask].sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + 1) < 0;
+	}
+};
+
+#endif
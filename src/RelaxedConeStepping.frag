@@ -1,20 +1,64 @@
 #version 330 core
 
-uniform float depth;
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+
+// the hit point is never in front of the mesh, so fragments behind the depth buffer can still be rejected early
+#ifdef GL_ARB_conservative_depth
+#extension GL_ARB_conservative_depth : enable
+layout(depth_greater) out float gl_FragDepth;
+#endif
+
 uniform int cone_steps;
 uniform int binary_steps;
 uniform int display_mode;
 uniform bool cell_max_trace;
 uniform bool show_convergence;
+uniform bool footprint_lod;
+uniform bool depth_only; // depth prepass, the color is not written
+uniform mat4 projectionMatrix;
+uniform vec4 uvTransform; // uv bounds of the mesh, offset in xy and size in zw
+uniform bool clip_to_uv_bounds; // rays leaving the uv bounds leave the height field volume
+uniform float footprint_scale; // screen pixels per rendered pixel, inverted, 0.5 for the interleaved passes
 
 in vec2 texCoord;
 in vec3 eyeSpaceVert;
 in vec3 eyeSpaceTangent;
 in vec3 eyeSpaceBitangent;
 in vec3 eyeSpaceNormal;
-
-uniform sampler2D stepmap; // (height, cone half-angle tangent, df/dx, df/dy)
-uniform sampler2D texmap;
+in float eyeSpaceDepth; // eye space distance from the top to the bottom of the height field
+in float entryHeight; // below 1 on the side walls of the shell
+flat in float depth; // depth of the instance
+flat in ivec2 layers; // layers of the cone map and the texture, or the draw with bindless textures
+
+#ifdef RAY_SETUP
+// the rays of the compute path, written instead of stepping them
+layout(location = 0) out vec4 rayOrigin; // origin, entry distance, exit distance (negative if the ray leaves through a side)
+layout(location = 1) out vec4 rayDirection; // direction in texture space, depth of the instance
+layout(location = 2) out vec4 rayFootprint; // screen space derivatives of the entry point
+layout(location = 3) out ivec2 rayLayers; // cone map and texture array layers
+#endif
+
+#ifdef BINDLESS
+// cone map and texture handles of each draw, layers.x is the draw
+// bound to binding 0 from the application, the binding qualifier needs GLSL 4.20
+layout(std430) readonly buffer TextureHandles {
+	uvec2 handles[];
+};
+
+vec4 stepmapLod(vec2 uv, float lod) { return textureLod(sampler2D(handles[2 * layers.x]), uv, lod); }
+ivec2 stepmapSize(int lod) { return textureSize(sampler2D(handles[2 * layers.x]), lod); }
+vec4 texmapGrad(vec2 uv, vec2 dx, vec2 dy) { return textureGrad(sampler2D(handles[2 * layers.x + 1]), uv, dx, dy); }
+#else
+uniform sampler2DArray stepmap; // (height, cone half-angle tangent, df/dx, df/dy)
+uniform sampler2DArray texmap;
+
+vec4 stepmapLod(vec2 uv, float lod) { return textureLod(stepmap, vec3(uv, layers.x), lod); }
+ivec2 stepmapSize(int lod) { return textureSize(stepmap, lod).xy; }
+vec4 texmapGrad(vec2 uv, vec2 dx, vec2 dy) { return textureGrad(texmap, vec3(uv, layers.y), dx, dy); }
+#endif
 
 void main(void) {
 	vec3 dir = // viewing ray direction in texture space
@@ -27,13 +71,48 @@ void main(void) {
 	float l = sqrt(abs(1.0f - dir.z * dir.z)); // horizontal length of dir
 	// abs needed to avoid negatives from float inprecision
 
-	ivec2 texsize = textureSize(stepmap, 0);
+	// screen space derivatives of the entry point, taken before any non-uniform control flow
+	vec2 dx = dFdx(texCoord) * footprint_scale;
+	vec2 dy = dFdy(texCoord) * footprint_scale;
+
+	// step on the cone map level matching the pixel footprint
+	// coarser levels keep the max heights and min cones, so distant surfaces fetch fewer texels
+	// (not strictly conservative, thin features can be stepped over on coarse levels)
+	ivec2 basesize = stepmapSize(0);
+	float lod = 0.0f;
+	if (footprint_lod) {
+		vec2 footprint = max(abs(dx), abs(dy)) * basesize;
+		float max_lod = floor(log2(max(basesize.x, basesize.y))); // full mip chain
+		lod = floor(clamp(log2(max(footprint.x, footprint.y)), 0.0f, max_lod));
+	}
+
+	ivec2 texsize = stepmapSize(int(lod));
 	float mfs = 1.0f / max(texsize.x, texsize.y); // min feature size
 	
-	vec4 t = texture(stepmap, texCoord); // texture at starting coordinates
+	// on the side walls the ray enters below the top, the origin is where it would cross the top
+	float entryDist = (1.0f - entryHeight) / max(dir.z, 1e-4f);
+	vec2 origin = texCoord - dir.xy * entryDist;
+
+	// the ray leaves the volume at the bottom, or at the side walls along the uv bounds
+	float exitDist = 1.0f / dir.z;
+	bool sideExit = false;
+	if (clip_to_uv_bounds) {
+		vec2 bound = uvTransform.xy + step(0.0f, dir.xy) * uvTransform.zw; // the bounds the ray moves towards
+		vec2 toBound = mix(vec2(exitDist), (bound - origin) / dir.xy, greaterThan(abs(dir.xy), vec2(1e-6f)));
+		sideExit = min(toBound.x, toBound.y) < exitDist;
+		exitDist = min(exitDist, min(toBound.x, toBound.y));
+	}
+
+#ifdef RAY_SETUP
+	rayOrigin = vec4(origin, entryDist, sideExit ? -exitDist : exitDist);
+	rayDirection = vec4(dir, depth);
+	rayFootprint = vec4(dx, dy);
+	rayLayers = layers;
+#else
+	vec4 t = stepmapLod(texCoord, lod); // texture at starting coordinates
 
 // Cone stepping
-	float dist = 0.0f;
+	float dist = entryDist;
 	float s; // step length
 	int step_count = 0;
 
@@ -42,12 +121,12 @@ void main(void) {
 		vec2 itexsize = 1.0f / texsize;
 		vec2 idir = 1.0f / dir.xy;
 		vec2 dirSign = vec2(dir.x < 0 ? -1 : 1, dir.y < 0 ? -1 : 1) * 0.5 * itexsize;
-		while (1.0f - dir.z * dist > t.r && step_count < cone_steps) // while above the surface
+		while (1.0f - dir.z * dist > t.r && dist < exitDist && step_count < cone_steps) // while above the surface inside the volume
 		{
 			// set step size (see documentation)
 			float tng = t.g * t.g;
 			s = (1.0f - dir.z * dist - t.r) * tng / (l + dir.z * tng);
-			vec2 p = texCoord + dir.xy * (dist + s);
+			vec2 p = origin + dir.xy * (dist + s);
       vec2 cellCenter = (floor(p*texsize - 0.5f) + 1) * itexsize;
       vec2 wall = cellCenter + dirSign;
       vec2 stepToCellBorder = (wall - p) * idir;
@@ -55,11 +134,11 @@ void main(void) {
       s += w;
 			dist += s; // increase distance
 
-			t = texture(stepmap, texCoord + dir.xy * dist); // new location and height
+			t = stepmapLod(origin + dir.xy * dist, lod); // new location and height
 			step_count++;
 		}
 	} else {
-		while (1.0f - dir.z * dist > t.r && step_count < cone_steps) // while above the surface
+		while (1.0f - dir.z * dist > t.r && dist < exitDist && step_count < cone_steps) // while above the surface inside the volume
 		{
 			// set step size (see documentation)
 			float tng = t.g * t.g;
@@ -67,13 +146,15 @@ void main(void) {
 				+ mfs; // correct by minimum feature size
 			dist += s; // increase distance
 
-			t = texture(stepmap, texCoord + dir.xy * dist); // new location and height
+			t = stepmapLod(origin + dir.xy * dist, lod); // new location and height
 			step_count++;
 		}
 	}
 
-	if (1.0f - dir.z * dist > t.r) // if we are still above the surface
-		s = 1.0f / dir.z - dist; // search on the rest of the distance to the bottom
+	if (1.0f - dir.z * dist > t.r) { // if we are still above the surface
+		if (sideExit && dist >= exitDist) discard; // the ray left through a side without hitting the surface
+		s = exitDist - dist; // search on the rest of the distance to the bottom
+	}
 
 // Binary search (with mfs accuracy)
 	for (int i = 0; i < binary_steps; ++i) {
@@ -89,11 +170,21 @@ void main(void) {
 			// we are within mfs
 			break;
 		}
-		t = texture(stepmap, texCoord + dir.xy * dist);
+		t = stepmapLod(origin + dir.xy * dist, lod);
 	}
 
 	// return the vector length needed to hit the height-map
-	vec2 uv = texCoord + dir.xy * dist;
+	vec2 uv = origin + dir.xy * dist;
+
+// Output depth
+	// the ray descends dir.z * dist of the height field, along the viewing ray in eye space
+	// never negative, depth_greater promises the depth only moves away from the rasterized one
+	vec3 view = normalize(eyeSpaceVert);
+	float descent = min(dir.z * max(dist - entryDist, 0.0f), 1.0f) * eyeSpaceDepth / max(dot(view, -normalize(eyeSpaceNormal)), 1e-4f);
+	descent = max(descent, 0.0f);
+	vec4 hit = projectionMatrix * vec4(eyeSpaceVert + view * descent, 1.0f);
+	gl_FragDepth = (hit.z / hit.w) * 0.5f * (gl_DepthRange.far - gl_DepthRange.near) + 0.5f * (gl_DepthRange.far + gl_DepthRange.near);
+	if (depth_only) return;
 
 // Output color
 	if (show_convergence && !(1.0f - dir.z * (dist - mfs) > t.r && 1.0f - dir.z * (dist + mfs) < t.r)) {
@@ -103,7 +194,7 @@ void main(void) {
 
 	switch (display_mode) {
 		case 0: // Color texture
-			gl_FragColor = texture(texmap, uv);
+			gl_FragColor = texmapGrad(uv, dx, dy); // derivatives of the hit point are discontinuous
 			break;
 		case 1: // Heights
 			gl_FragColor = vec4(vec3(t.r), 1.0f);
@@ -117,8 +208,8 @@ void main(void) {
 
 			// scale normals to reflect displayed geometry
 			t.xy = t.ba * 2.0f - vec2(1.0f);
-			t.x = -t.x * depth * texsize.x;
-			t.y = -t.y * depth * texsize.y;
+			t.x = -t.x * depth * basesize.x; // derivatives are per base level texel
+			t.y = -t.y * depth * basesize.y;
 			t.z = 1.0f;
 			t.xyz = normalize(t.xyz);
 			t.xy = t.xy / 2.0f + vec2(0.5f);
@@ -126,4 +217,5 @@ void main(void) {
 			gl_FragColor = vec4(t.xyz, 1.0f);
 			break;
 	}
+#endif
 }
@@ -0,0 +1,268 @@
+// STD
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// GLM
+#include <glm/gtc/type_ptr.hpp>
+
+#include "file_utils.hpp"
+#include "ResolutionScaler.hpp"
+
+ResolutionScaler::ResolutionScaler() {
+	resolve_program = create_program("Fullscreen.vert", "Resolve.frag");
+	upscale_program = create_program("Fullscreen.vert", "Upscale.frag");
+	glCreateVertexArrays(1, &empty_vao);
+	glCreateQueries(GL_TIME_ELAPSED, query_count, queries);
+}
+
+ResolutionScaler::~ResolutionScaler() {
+	glDeleteProgram(resolve_program);
+	glDeleteProgram(upscale_program);
+	glDeleteVertexArrays(1, &empty_vao);
+	glDeleteQueries(query_count, queries);
+	delete_target();
+}
+
+void ResolutionScaler::resize(int width, int height) {
+	window_width = width;
+	window_height = height;
+}
+
+void ResolutionScaler::delete_target() {
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &color_texture);
+	glDeleteTextures(1, &depth_texture);
+	glDeleteFramebuffers(2, history_framebuffers);
+	glDeleteTextures(2, history_colors);
+	glDeleteTextures(2, history_depths);
+	glDeleteFramebuffers(1, &trace_framebuffer);
+	glDeleteTextures(1, &trace_color);
+	glDeleteTextures(1, &trace_depth);
+}
+
+void ResolutionScaler::allocate_target() {
+	delete_target();
+
+	target_width = window_width;
+	target_height = window_height;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &color_texture);
+	glTextureStorage2D(color_texture, 1, GL_RGBA8, target_width, target_height);
+	glTextureParameteri(color_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(color_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(color_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(color_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &depth_texture);
+	glTextureStorage2D(depth_texture, 1, GL_DEPTH_COMPONENT24, target_width, target_height);
+	glTextureParameteri(depth_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(depth_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, color_texture, 0);
+	glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depth_texture, 0);
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::fprintf(stderr, "Error: Could not create the %dx%d render target.\n", target_width, target_height);
+	}
+
+	// color and depth of the resolved frames
+	glCreateTextures(GL_TEXTURE_2D, 2, history_colors);
+	glCreateTextures(GL_TEXTURE_2D, 2, history_depths);
+	glCreateFramebuffers(2, history_framebuffers);
+	const GLenum draw_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+	for (int i = 0; i < 2; i++) {
+		glTextureStorage2D(history_colors[i], 1, GL_RGBA8, target_width, target_height);
+		glTextureParameteri(history_colors[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(history_colors[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(history_colors[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(history_colors[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glTextureStorage2D(history_depths[i], 1, GL_R32F, target_width, target_height);
+		glTextureParameteri(history_depths[i], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(history_depths[i], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(history_depths[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(history_depths[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glNamedFramebufferTexture(history_framebuffers[i], GL_COLOR_ATTACHMENT0, history_colors[i], 0);
+		glNamedFramebufferTexture(history_framebuffers[i], GL_COLOR_ATTACHMENT1, history_depths[i], 0);
+		glNamedFramebufferDrawBuffers(history_framebuffers[i], 2, draw_buffers);
+	}
+	history_valid = false;
+
+	// the interleaved passes, only read by the resolve with texelFetch
+	trace_target_width = (target_width + 1) / 2;
+	trace_target_height = 2 * ((target_height + 1) / 2);
+	glCreateTextures(GL_TEXTURE_2D, 1, &trace_color);
+	glTextureStorage2D(trace_color, 1, GL_RGBA8, trace_target_width, trace_target_height);
+	glCreateTextures(GL_TEXTURE_2D, 1, &trace_depth);
+	glTextureStorage2D(trace_depth, 1, GL_DEPTH_COMPONENT24, trace_target_width, trace_target_height);
+	for (GLuint texture : {trace_color, trace_depth}) {
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	glCreateFramebuffers(1, &trace_framebuffer);
+	glNamedFramebufferTexture(trace_framebuffer, GL_COLOR_ATTACHMENT0, trace_color, 0);
+	glNamedFramebufferTexture(trace_framebuffer, GL_DEPTH_ATTACHMENT, trace_depth, 0);
+	if (glCheckNamedFramebufferStatus(trace_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::fprintf(stderr, "Error: Could not create the %dx%d interleaved render target.\n", trace_target_width, trace_target_height);
+	}
+}
+
+void ResolutionScaler::adapt_scale() {
+	// the query issued query_count frames ago, skipped while the GPU is still behind
+	const GLuint query = queries[query_index];
+	if (!query_issued[query_index]) return;
+
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return;
+
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+	query_issued[query_index] = false;
+	gpu_milliseconds = nanoseconds * 1e-6f;
+
+	if (!dynamic || gpu_milliseconds <= 0.0f) return;
+
+	// the stepping time is about proportional to the pixel count, the square of the scale
+	// a dead band and moving halfway keep timer noise and the frames of latency from making it oscillate
+	const float error = gpu_milliseconds / target_milliseconds;
+	if (error > 0.95f && error < 1.05f) return;
+	const float wanted = scale / std::sqrt(error);
+	scale += 0.5f * (wanted - scale);
+}
+
+bool ResolutionScaler::begin() {
+	if (window_width <= 0 || window_height <= 0) return false;
+
+	adapt_scale();
+	scale = std::clamp(scale, std::min(min_scale, 1.0f), 1.0f);
+
+	if (target_width != window_width || target_height != window_height) allocate_target();
+
+	render_width = std::max(1, static_cast<int>(std::lround(window_width * scale)));
+	render_height = std::max(1, static_cast<int>(std::lround(window_height * scale)));
+
+	// the pixels of the 2x2 blocks traced this frame, alternating diagonally so consecutive frames complement each other
+	static const glm::ivec2 quarter_offsets[4] = {{0, 0}, {1, 1}, {1, 0}, {0, 1}};
+	interleaved = interleave == 2 || interleave == 4;
+	pass_width = (render_width + 1) / 2;
+	pass_height = (render_height + 1) / 2;
+	if (interleave == 2) {
+		// a checkerboard is one pixel of each block on the even rows and the other one on the odd rows
+		const int phase = interleave_frame % 2;
+		pass_total = 2;
+		pass_offsets[0] = glm::ivec2(phase, 0);
+		pass_offsets[1] = glm::ivec2(1 - phase, 1);
+	} else {
+		pass_total = 1;
+		pass_offsets[0] = quarter_offsets[interleave_frame % 4];
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, interleaved ? trace_framebuffer : framebuffer);
+	glViewport(0, 0, get_traced_width(), get_traced_height());
+
+	// a query still in flight keeps its frame, this one goes untimed
+	if (!query_issued[query_index]) glBeginQuery(GL_TIME_ELAPSED, queries[query_index]);
+
+	return true;
+}
+
+glm::mat4 ResolutionScaler::begin_pass(int pass) {
+	if (!interleaved) {
+		glViewport(0, 0, render_width, render_height);
+		return glm::mat4(1.0f);
+	}
+
+	glViewport(0, pass * pass_height, pass_width, pass_height);
+
+	// pixel p of the pass is centered on the pixel 2p + offset of the full resolution render, so screen position x
+	// (in full resolution pixels) maps to (x - offset + 0.5) / 2 in the pass, an affine map of the clip space
+	const glm::vec2 render_size(render_width, render_height);
+	const glm::vec2 pass_size(pass_width, pass_height);
+	const glm::vec2 scale = render_size / (2.0f * pass_size);
+	const glm::vec2 shift = (0.5f * render_size - glm::vec2(pass_offsets[pass]) + 0.5f) / pass_size - 1.0f;
+	glm::mat4 jitter(1.0f);
+	jitter[0][0] = scale.x;
+	jitter[1][1] = scale.y;
+	jitter[3][0] = shift.x;
+	jitter[3][1] = shift.y;
+	return jitter;
+}
+
+void ResolutionScaler::resolve(const glm::mat4 &view_projection) {
+	const int write_index = 1 - history_index;
+	glBindFramebuffer(GL_FRAMEBUFFER, history_framebuffers[write_index]);
+
+	glViewport(0, 0, render_width, render_height);
+
+	glUseProgram(resolve_program);
+	const glm::mat4 reprojection = history_view_projection * glm::inverse(view_projection);
+	const bool still = view_projection == history_view_projection && render_width == history_width && render_height == history_height;
+	glUniform1i(glGetUniformLocation(resolve_program, "current"), 0);
+	glUniform1i(glGetUniformLocation(resolve_program, "currentDepth"), 1);
+	glUniform1i(glGetUniformLocation(resolve_program, "history"), 2);
+	glUniform1i(glGetUniformLocation(resolve_program, "historyDepth"), 3);
+	glUniform1i(glGetUniformLocation(resolve_program, "passCount"), pass_total);
+	glUniform2iv(glGetUniformLocation(resolve_program, "passOffsets"), 2, glm::value_ptr(pass_offsets[0]));
+	glUniform2i(glGetUniformLocation(resolve_program, "passSize"), pass_width, pass_height);
+	glUniform2i(glGetUniformLocation(resolve_program, "renderSize"), render_width, render_height);
+	glUniform2f(glGetUniformLocation(resolve_program, "historyScale"), history_scale.x, history_scale.y);
+	glUniform1i(glGetUniformLocation(resolve_program, "historyValid"), history_valid);
+	glUniform1i(glGetUniformLocation(resolve_program, "historyStill"), still);
+	glUniformMatrix4fv(glGetUniformLocation(resolve_program, "reprojection"), 1, false, glm::value_ptr(reprojection));
+	glUniformMatrix4fv(glGetUniformLocation(resolve_program, "inverseReprojection"), 1, false, glm::value_ptr(glm::inverse(reprojection)));
+
+	glBindTextureUnit(0, trace_color);
+	glBindTextureUnit(1, trace_depth);
+	glBindTextureUnit(2, history_colors[history_index]);
+	glBindTextureUnit(3, history_depths[history_index]);
+	glBindVertexArray(empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	history_index = write_index;
+	history_valid = true;
+	history_view_projection = view_projection;
+	history_scale = glm::vec2(static_cast<float>(render_width) / target_width, static_cast<float>(render_height) / target_height);
+	history_width = render_width;
+	history_height = render_height;
+}
+
+void ResolutionScaler::end(const glm::mat4 &view_projection) {
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	GLuint resolved = color_texture;
+	if (interleaved) {
+		resolve(view_projection);
+		resolved = history_colors[history_index];
+	} else {
+		history_valid = false; // the history is not kept up to date
+	}
+	interleave_frame++;
+
+	if (!query_issued[query_index]) {
+		glEndQuery(GL_TIME_ELAPSED);
+		query_issued[query_index] = true;
+	}
+	query_index = (query_index + 1) % query_count;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, window_width, window_height);
+
+	glUseProgram(upscale_program);
+	glUniform1i(glGetUniformLocation(upscale_program, "source"), 0);
+	glUniform2f(glGetUniformLocation(upscale_program, "sourceScale"),
+							static_cast<float>(render_width) / target_width, static_cast<float>(render_height) / target_height);
+	glUniform1i(glGetUniformLocation(upscale_program, "edgeAware"), edge_aware && (render_width < window_width || render_height < window_height));
+
+	glBindTextureUnit(0, resolved);
+	glBindVertexArray(empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// unbind
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
@@ -0,0 +1,123 @@
+#ifndef RESOLUTION_SCALER_HPP
+#define RESOLUTION_SCALER_HPP
+
+// GLAD
+#include <glad/gl.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Offscreen color and depth target the scene is rendered to at a fraction of the window resolution,
+// upscaled to the window afterwards.
+// With dynamic scaling, the fraction follows the GPU time of the scene (timer queries, read a few frames late
+// so they never stall) towards a target frame time.
+// With interleaving, the scene only traces some of the pixels each frame, the others are reprojected
+// from the previous frame, so a still image is complete after interleave frames.
+// The traced pixels are rendered compactly at half the width and height, in one pass per traced pixel of each
+// 2x2 block (two for a checkerboard, one for a quarter), so the pixels that are not traced are never rasterized.
+class ResolutionScaler {
+public:
+	// requires a current context
+	ResolutionScaler();
+	~ResolutionScaler();
+
+	ResolutionScaler(const ResolutionScaler &) = delete;
+	ResolutionScaler &operator=(const ResolutionScaler &) = delete;
+
+	// settings
+	bool dynamic = false;
+	float target_milliseconds = 1000.0f / 60.0f; // GPU time of the scene
+	float min_scale = 0.25f;
+	float scale = 1.0f; // rendered fraction of the window width and height, adapted by dynamic scaling
+	bool edge_aware = true; // sharpen the upscaled image where it has little contrast, plain bilinear otherwise
+	int interleave = 1; // 1 traces every pixel each frame, 2 a checkerboard, 4 one pixel of each 2x2 block
+
+	// GPU time of the scene in the last measured frame, 0 until a measurement is available
+	float gpu_milliseconds = 0.0f;
+
+	// size of the window framebuffer
+	void resize(int width, int height);
+
+	// binds the target and starts timing, returns false if the window has no area
+	bool begin();
+	// the scene is drawn once per pass, 1 unless the checkerboard is interleaved
+	int pass_count() const { return interleaved ? pass_total : 1; }
+	// sets the viewport of the pass and returns the matrix to apply after the projection,
+	// which moves the pixel centers of the pass onto the pixels it traces
+	glm::mat4 begin_pass(int pass);
+	// scale of screen space derivatives to the spacing of the rendered pixels, 0.5 for the compact passes
+	float footprint_scale() const { return interleaved ? 0.5f : 1.0f; }
+	// fills the pixels not traced this frame, stops timing and upscales the target to the window framebuffer
+	void end(const glm::mat4 &view_projection);
+	// the previous frames no longer show the scene, to be called when anything but the view changes
+	void invalidate_history() { history_valid = false; }
+
+	// size the scene is currently rendered at
+	int get_width() const { return render_width; }
+	int get_height() const { return render_height; }
+
+	// the target the scene is drawn to this frame, valid after begin
+	GLuint get_color_texture() const { return interleaved ? trace_color : color_texture; }
+	GLuint get_depth_texture() const { return interleaved ? trace_depth : depth_texture; }
+	int get_target_width() const { return interleaved ? trace_target_width : target_width; }
+	int get_target_height() const { return interleaved ? trace_target_height : target_height; }
+	// the part of it the passes render to
+	int get_traced_width() const { return interleaved ? pass_width : render_width; }
+	int get_traced_height() const { return interleaved ? pass_height * pass_total : render_height; }
+
+private:
+	int window_width = 0;
+	int window_height = 0;
+	int render_width = 0;
+	int render_height = 0;
+
+	// allocated at the window size, only the scaled part is rendered to
+	int target_width = 0;
+	int target_height = 0;
+	GLuint framebuffer = 0;
+	GLuint color_texture = 0;
+	GLuint depth_texture = 0;
+
+	// the compact passes of interleaved frames, stacked vertically, allocated for two passes at half the window size
+	int trace_target_width = 0;
+	int trace_target_height = 0;
+	GLuint trace_framebuffer = 0;
+	GLuint trace_color = 0;
+	GLuint trace_depth = 0;
+
+	// passes of the current frame
+	bool interleaved = false;
+	int pass_total = 1;
+	int pass_width = 0; // of each pass
+	int pass_height = 0;
+	glm::ivec2 pass_offsets[2] = {}; // pixel of each 2x2 block traced by the pass
+
+	// resolved frames, the last one is reprojected into the next
+	GLuint history_framebuffers[2] = {};
+	GLuint history_colors[2] = {};
+	GLuint history_depths[2] = {};
+	int history_index = 0; // the last one written
+	bool history_valid = false;
+	glm::mat4 history_view_projection = glm::mat4(1.0f);
+	glm::vec2 history_scale = glm::vec2(1.0f); // part of the history that was rendered to
+	int history_width = 0; // size it was rendered at
+	int history_height = 0;
+	int interleave_frame = 0;
+
+	GLuint resolve_program = 0;
+	GLuint upscale_program = 0;
+	GLuint empty_vao = 0; // the full screen triangle has no vertex data
+
+	// timer queries of the last frames, reused in turn
+	static constexpr int query_count = 4;
+	GLuint queries[query_count] = {};
+	bool query_issued[query_count] = {};
+	int query_index = 0;
+
+	void allocate_target();
+	void delete_target();
+	void resolve(const glm::mat4 &view_projection);
+	void adapt_scale();
+};
+
+#endif
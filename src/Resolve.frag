@@ -0,0 +1,109 @@
+#version 330 core
+
+// Scatters the pixels traced by the compact passes of this frame to their place in the full resolution frame,
+// and fills the others from the previous resolved frame, reprojected with the camera,
+// or from the traced neighbours where the previous frame did not see the surface.
+
+// uniforms
+uniform sampler2D current; // the passes of this frame, stacked vertically
+uniform sampler2D currentDepth;
+uniform sampler2D history; // previous resolved frame
+uniform sampler2D historyDepth;
+
+uniform int passCount; // 2 for a checkerboard, 1 for one pixel of each 2x2 block
+uniform ivec2 passOffsets[2]; // pixel of each 2x2 block traced by each pass
+uniform ivec2 passSize; // pixels of each pass
+uniform ivec2 renderSize; // pixels of the full resolution frame
+uniform vec2 historyScale; // part of the history that was rendered to
+uniform bool historyValid;
+uniform bool historyStill; // rendered with the same view and size, so it lines up with this frame
+uniform mat4 reprojection; // current to previous clip space
+uniform mat4 inverseReprojection; // previous to current clip space
+
+// outputs
+layout(location = 0) out vec4 resolvedColor;
+layout(location = 1) out float resolvedDepth;
+
+// texel of the pixel in the passes, negative if it was not traced this frame
+ivec2 tracedTexel(ivec2 pixel) {
+	for (int i = 0; i < passCount; i++) {
+		if ((pixel & 1) == passOffsets[i]) return (pixel >> 1) + ivec2(0, i * passSize.y);
+	}
+	return ivec2(-1);
+}
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 texel = tracedTexel(pixel);
+	if (texel.x >= 0) {
+		resolvedColor = texelFetch(current, texel, 0);
+		resolvedDepth = texelFetch(currentDepth, texel, 0).r;
+		return;
+	}
+
+	// a still image keeps the pixels traced in the previous frames as they are, silhouettes included, and converges
+	if (historyValid && historyStill) {
+		resolvedColor = texelFetch(history, pixel, 0);
+		resolvedDepth = texelFetch(historyDepth, pixel, 0).r;
+		return;
+	}
+
+	// traced neighbours, there are some in every 3x3 block
+	vec3 sum = vec3(0.0f);
+	vec3 minColor = vec3(1.0f);
+	vec3 maxColor = vec3(0.0f);
+	float count = 0.0f;
+	float depth = 1.0f; // the nearest, so foreground edges are kept
+	float maxDepth = 0.0f;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			ivec2 neighbour = pixel + ivec2(x, y);
+			if (any(lessThan(neighbour, ivec2(0))) || any(greaterThanEqual(neighbour, renderSize))) continue;
+			ivec2 neighbourTexel = tracedTexel(neighbour);
+			if (neighbourTexel.x < 0) continue;
+
+			vec3 color = texelFetch(current, neighbourTexel, 0).rgb;
+			sum += color;
+			minColor = min(minColor, color);
+			maxColor = max(maxColor, color);
+			count++;
+			float neighbourDepth = texelFetch(currentDepth, neighbourTexel, 0).r;
+			depth = min(depth, neighbourDepth);
+			maxDepth = max(maxDepth, neighbourDepth);
+		}
+	}
+	vec3 color = sum / max(count, 1.0f);
+
+	if (historyValid) {
+		// where the surface of the nearest neighbour was in the previous frame
+		vec2 uv = gl_FragCoord.xy / vec2(renderSize);
+		vec4 previous = reprojection * vec4(vec3(uv, depth) * 2.0f - 1.0f, 1.0f);
+		previous.xy /= previous.w;
+		vec2 previousUV = previous.xy * 0.5f + 0.5f;
+
+		if (all(greaterThanEqual(previousUV, vec2(0.0f))) && all(lessThanEqual(previousUV, vec2(1.0f)))) {
+			vec2 historyUV = previousUV * historyScale;
+			float historySurface = texture(historyDepth, historyUV).r;
+
+			// the surface the history shows there, moved into this frame with its own depth
+			vec4 surface = inverseReprojection * vec4(vec3(previousUV, historySurface) * 2.0f - 1.0f, 1.0f);
+			surface.xyz /= surface.w;
+			vec2 surfaceUV = surface.xy * 0.5f + 0.5f;
+			float surfaceDepth = surface.z * 0.5f + 0.5f;
+
+			// it has to land on this pixel between the nearest and farthest neighbour surfaces,
+			// 1 - depth is about inversely proportional to the eye distance, accept 5% beyond them
+			// anything else was hidden in the previous frame or is another surface
+			bool samePixel = length((surfaceUV - uv) * vec2(renderSize)) <= 1.0f;
+			float tolerance = 0.05f * (1.0f - surfaceDepth) + 1e-6f;
+			if (samePixel && surfaceDepth >= depth - tolerance && surfaceDepth <= maxDepth + tolerance) {
+				// the history is kept within the neighbours to limit ghosting
+				color = clamp(texture(history, historyUV).rgb, minColor, maxColor);
+				depth = surfaceDepth;
+			}
+		}
+	}
+
+	resolvedColor = vec4(color, 1.0f);
+	resolvedDepth = depth;
+}
@@ -9,11 +9,18 @@
 #include <glm/gtx/transform.hpp>
 
 // STD
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <optional>
+#include <tuple>
 #include <vector>
 #include <iostream>
 
 #include "ConeSteppingObject.hpp"
 #include "file_utils.hpp"
+#include "parallel_for.hpp"
 #include "Scene.hpp"
 
 // quad vertices
@@ -28,107 +35,437 @@ static const std::vector<PosUVVertex> quad_vertices = {
 		{{-1.0f, 0.0f, 1.0f},  {0.0f, 0.0f}},
 };
 
-Scene::Scene() :
+// layout of glMultiDrawElementsIndirect commands
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+std::vector<Instance> grid_instances(int size) {
+	std::vector<Instance> instances;
+	instances.reserve(static_cast<size_t>(size) * size);
+	const float offset = size - 1.0f; // the quad spans 2 units
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			Instance instance;
+			instance.world = glm::translate(glm::vec3(2.0f * x - offset, 0.0f, 2.0f * z - offset));
+			instances.push_back(instance);
+		}
+	}
+	return instances;
+}
+
+// the mesh fitted to the size of the quad, or the quad if it cannot be loaded
+static ConeSteppingObject load_object(const std::filesystem::path &mesh_path) {
+	std::optional<Mesh> mesh;
+	if (!mesh_path.empty()) {
+		mesh = load_obj(mesh_path);
+		if (mesh) {
+			mesh->fit_to_quad();
+		} else {
+			std::cerr << "Error: Could not load mesh " << mesh_path.string() << ", using a quad instead." << std::endl;
+		}
+	}
+
+	return mesh ? ConeSteppingObject(*mesh) : ConeSteppingObject(quad_vertices);
+}
+
+Scene::Scene(const std::filesystem::path &mesh_path) :
 	camera(Camera(glm::vec3(0.0f, 1.0f, -1.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 16.0f/9.0f)),
 	controls(Controls(camera)),
-	quad(ConeSteppingObject(quad_vertices))
+	object(load_object(mesh_path))
 {
-// create shaders
-	GLint success;
-	GLchar infoLog[512];
+	program = create_program("ConeStepping.vert", "RelaxedConeStepping.frag");
 
-// stages
-	// vertex
-	const GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-	load_shader_from_file("ConeStepping.vert", vertex_shader);
-	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-			glGetShaderInfoLog(vertex_shader, 512, NULL, infoLog);
-			std::cerr << "Shader Compilation Error: " << infoLog << std::endl;
+	// the bindless variant of the fragment shader needs the extensions
+	if (bindless_textures.is_supported()) {
+		bindless_program = create_program("ConeStepping.vert", "RelaxedConeStepping.frag", "#define BINDLESS\n");
+		if (bindless_program) {
+			// the shader is GLSL 3.30, which cannot declare the binding of the handle buffer
+			const GLuint handles_block = glGetProgramResourceIndex(bindless_program, GL_SHADER_STORAGE_BLOCK, "TextureHandles");
+			if (handles_block != GL_INVALID_INDEX) glShaderStorageBlockBinding(bindless_program, handles_block, 0);
+		}
+		use_bindless = bindless_program != 0;
 	}
 
-	// fragment
-	const GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-	load_shader_from_file("RelaxedConeStepping.frag", fragment_shader);
+	glGenBuffers(1, &handle_ssbo);
+	glGenBuffers(1, &indirect_buffer);
 
-	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-			glGetShaderInfoLog(fragment_shader, 512, NULL, infoLog);
-			std::cerr << "Shader Compilation Error: " << infoLog << std::endl;
-	}
+// instance attributes
+	glGenBuffers(1, &instance_vbo);
 
-// program
-	program = glCreateProgram();
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
-	glLinkProgram(program);
+	glBindVertexArray(object.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
 
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if (!success) {
-			glGetProgramInfoLog(program, 512, NULL, infoLog);
-			std::cerr << "Program Linking Error: " << infoLog << std::endl;
+	// world matrix
+	for (GLuint column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceAttributes),
+				(void *)(offsetof(InstanceAttributes, world) + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(3 + column, 1);
 	}
+
+	// depth scale
+	glEnableVertexAttribArray(7);
+	glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceAttributes), (void *)offsetof(InstanceAttributes, depth_scale));
+	glVertexAttribDivisor(7, 1);
+
+	// texture array layers
+	glEnableVertexAttribArray(8);
+	glVertexAttribIPointer(8, 2, GL_INT, sizeof(InstanceAttributes), (void *)offsetof(InstanceAttributes, layers));
+	glVertexAttribDivisor(8, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 Scene::~Scene() {
 	// delete shaders
 	glDeleteProgram(program);
+
+	glDeleteProgram(bindless_program);
+
+	// delete buffers
+	glDeleteBuffers(1, &instance_vbo);
+	glDeleteBuffers(1, &handle_ssbo);
+	glDeleteBuffers(1, &indirect_buffer);
+}
+
+void Scene::sort_instances() {
+	// 0 stands for the selected texture
+	const std::vector<Instance> &list = instances.instances;
+	std::vector<GLuint> stepmap_ids(list.size());
+	std::vector<GLuint> texmap_ids(list.size());
+	for (size_t i = 0; i < list.size(); i++) {
+		stepmap_ids[i] = list[i].stepmap ? list[i].stepmap : object.stepmapTex;
+		texmap_ids[i] = list[i].texmap ? list[i].texmap : object.texmapTex;
+	}
+
+	sorted_attributes.clear();
+	sorted_attributes.reserve(list.size());
+	batches.clear();
+	std::vector<size_t> order(list.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	if (use_bindless && bindless_program) {
+		// instances sharing textures are made consecutive, each run is one draw command with its own handles
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return std::tie(stepmap_ids[a], texmap_ids[a]) < std::tie(stepmap_ids[b], texmap_ids[b]);
+		});
+
+		std::vector<GLuint64> handles;
+		for (size_t j = 0; j < order.size(); j++) {
+			const size_t i = order[j];
+			if (j == 0 || stepmap_ids[i] != stepmap_ids[order[j - 1]] || texmap_ids[i] != texmap_ids[order[j - 1]]) {
+				handles.push_back(bindless_textures.handle(stepmap_ids[i]));
+				handles.push_back(bindless_textures.handle(texmap_ids[i]));
+				batches.push_back({-1, -1, sorted_attributes.size(), sorted_attributes.size()});
+			}
+			batches.back().end++;
+			const GLint batch = static_cast<GLint>(batches.size() - 1);
+			sorted_attributes.push_back({list[i].world, list[i].depth_scale, {batch, batch}});
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, handle_ssbo);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, handles.size() * sizeof(GLuint64), handles.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	} else {
+		// resolve the textures to array layers
+		std::vector<TextureLayer> stepmaps(list.size());
+		std::vector<TextureLayer> texmaps(list.size());
+		for (size_t i = 0; i < list.size(); i++) {
+			stepmaps[i] = texture_arrays.layer_of(stepmap_ids[i]);
+			texmaps[i] = texture_arrays.layer_of(texmap_ids[i]);
+		}
+
+		// instances sharing arrays are made consecutive so each batch is a single instanced draw
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return std::tie(stepmaps[a].size_class, texmaps[a].size_class) < std::tie(stepmaps[b].size_class, texmaps[b].size_class);
+		});
+
+		for (size_t i : order) {
+			const TextureLayer &stepmap = stepmaps[i];
+			const TextureLayer &texmap = texmaps[i];
+			if (batches.empty() || batches.back().stepmap_class != stepmap.size_class || batches.back().texmap_class != texmap.size_class) {
+				batches.push_back({stepmap.size_class, texmap.size_class, sorted_attributes.size(), sorted_attributes.size()});
+			}
+			batches.back().end++;
+			sorted_attributes.push_back({list[i].world, list[i].depth_scale, {stepmap.layer, texmap.layer}});
+		}
+	}
+
+	instances.changed = false;
+	sorted_stepmap = object.stepmapTex;
+	sorted_texmap = object.texmapTex;
+	sorted_bindless = use_bindless && bindless_program;
+	cull_pending = true;
+}
+
+bool Scene::is_visible(const InstanceAttributes &instance, const glm::mat4 &view_projection, const glm::vec3 &eye) const {
+	// the displaced surface lies within depth below the mesh, the box is grown to contain it in every direction
+	const float extrusion = object.depth * instance.depth_scale * object.uv_to_world;
+	const glm::vec3 lo = object.bounds_min - glm::vec3(extrusion);
+	const glm::vec3 hi = object.bounds_max + glm::vec3(extrusion);
+
+	// outside if all corners are beyond the same clip plane
+	const glm::mat4 world_view_projection = view_projection * instance.world;
+	int outside[6] = {};
+	for (int corner = 0; corner < 8; corner++) {
+		const glm::vec4 p = world_view_projection * glm::vec4(corner & 1 ? hi.x : lo.x, corner & 2 ? hi.y : lo.y, corner & 4 ? hi.z : lo.z, 1.0f);
+		outside[0] += p.x < -p.w;
+		outside[1] += p.x > p.w;
+		outside[2] += p.y < -p.w;
+		outside[3] += p.y > p.w;
+		outside[4] += p.z < -p.w;
+		outside[5] += p.z > p.w;
+	}
+	for (int plane = 0; plane < 6; plane++) {
+		if (outside[plane] == 8) return false;
+	}
+
+	// facing away if the eye is behind the planes of all faces, the normal cone only survives rotations and uniform scales
+	if (object.normal_cone_cutoff < 1.0f) {
+		const glm::mat3 linear(instance.world);
+		const float scale = glm::length(linear[0]);
+		const bool similarity = std::abs(glm::length(linear[1]) - scale) < 1e-3f * scale &&
+				std::abs(glm::length(linear[2]) - scale) < 1e-3f * scale && glm::determinant(linear) > 0.0f;
+		if (similarity) {
+			const glm::vec3 center = glm::vec3(instance.world * glm::vec4(0.5f * (lo + hi), 1.0f));
+			const float radius = 0.5f * glm::length(hi - lo) * scale;
+			const glm::vec3 axis = glm::normalize(linear * object.normal_cone_axis);
+			const glm::vec3 to_center = center - eye;
+			if (glm::dot(to_center, axis) >= object.normal_cone_cutoff * glm::length(to_center) + radius) return false;
+		}
+	}
+
+	return true;
+}
+
+void Scene::cull_instances(const glm::mat4 &view_projection) {
+	const glm::vec3 eye = glm::vec3(glm::inverse(camera.get_view_matrix())[3]);
+
+	std::vector<unsigned char> visible(sorted_attributes.size(), 1);
+	if (culling) {
+		// a test takes tens of nanoseconds, so grids up to one chunk run on the render thread
+		// and only larger ones wake the persistent worker pool
+		parallel_for(sorted_attributes.size(), 4096, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				visible[i] = is_visible(sorted_attributes[i], view_projection, eye);
+			}
+		});
+	}
+
+	// the visible instances of each batch stay consecutive
+	std::vector<InstanceAttributes> attributes;
+	attributes.reserve(sorted_attributes.size());
+	draw_ranges.resize(batches.size());
+	for (size_t b = 0; b < batches.size(); b++) {
+		draw_ranges[b].first = static_cast<GLuint>(attributes.size());
+		for (size_t i = batches[b].begin; i < batches[b].end; i++) {
+			if (visible[i]) attributes.push_back(sorted_attributes[i]);
+		}
+
+		// front to back, so nearer instances fill the depth buffer first and hide the stepping of farther ones
+		auto distance = [&](const InstanceAttributes &instance) { return glm::length(glm::vec3(instance.world[3]) - eye); };
+		std::sort(attributes.begin() + draw_ranges[b].first, attributes.end(), [&](const InstanceAttributes &first, const InstanceAttributes &second) {
+			return distance(first) < distance(second);
+		});
+		draw_ranges[b].count = static_cast<GLsizei>(attributes.size() - draw_ranges[b].first);
+	}
+	visible_instances = attributes.size();
+
+	glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+	glBufferData(GL_ARRAY_BUFFER, attributes.size() * sizeof(InstanceAttributes), attributes.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (sorted_bindless) {
+		std::vector<DrawElementsIndirectCommand> commands;
+		commands.reserve(draw_ranges.size());
+		for (const DrawRange &range : draw_ranges) {
+			commands.push_back({static_cast<GLuint>(object.index_count), static_cast<GLuint>(range.count), 0, 0, range.first});
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	culled_view_projection = view_projection;
+	culled_with_culling = culling;
+	culled_depth = object.depth;
+	cull_pending = false;
 }
 
 void Scene::render() {
+	// into the offscreen target at the scaled resolution
+	if (!resolution.begin()) return;
+
 	glEnable(GL_CULL_FACE);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
 	glClearColor(0.1f, 0.2f, 0.6f, 1.0f); // blue background
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	
-	// set world transformation
-	glm::mat4 worldMatrix = glm::identity<glm::mat4>();
+
+	// the compute path draws the shells with the texture arrays
+	bool compute = use_compute && compute_stepping.is_supported();
+	const bool bindless = use_bindless && bindless_program && !compute;
+	const HistorySettings settings = {cone_steps, binary_steps, display_mode, cell_max_trace, show_convergence, footprint_lod, silhouettes,
+	                                  bindless, compute, object.depth, object.stepmapTex, object.texmapTex};
+	if (instances.changed || settings != history_settings) resolution.invalidate_history();
+	history_settings = settings;
+
+	if (instances.changed || sorted_stepmap != object.stepmapTex || sorted_texmap != object.texmapTex || sorted_bindless != bindless) {
+		sort_instances();
+	}
+
+	// the rays are stepped with one pair of texture arrays, with several the fragment path below binds them per batch
+	if (batches.size() > 1) compute = false;
+
+	// culling only runs again when the view or the bounds change
+	const glm::mat4 view_projection = camera.get_projection_matrix() * camera.get_view_matrix();
+	if (cull_pending || view_projection != culled_view_projection || culling != culled_with_culling || object.depth != culled_depth) {
+		cull_instances(view_projection);
+	}
+
+	if (compute) {
+		// the rays of the nearest shells, then stepped in tiles
+		compute_stepping.begin_rays(resolution.get_depth_texture(), resolution.get_target_width(), resolution.get_target_height());
+		const GLuint ray_program = compute_stepping.get_ray_program();
+		glUseProgram(ray_program);
+		set_uniforms(ray_program);
+		glBindVertexArray(object.vao);
+		for (int pass = 0; pass < resolution.pass_count(); pass++) {
+			begin_pass(ray_program, pass);
+			draw_instances(false);
+		}
+		glBindVertexArray(0);
+
+		const GLuint step_program = compute_stepping.get_step_program();
+		glUseProgram(step_program);
+		set_uniforms(step_program);
+		const GLuint stepmap_array = batches.empty() ? 0 : texture_arrays.array(batches.front().stepmap_class);
+		const GLuint texmap_array = batches.empty() ? 0 : texture_arrays.array(batches.front().texmap_class);
+		compute_stepping.step_rays(resolution.get_color_texture(), resolution.get_traced_width(), resolution.get_traced_height(), stepmap_array, texmap_array);
+		glUseProgram(0);
+
+		// to the window
+		resolution.end(view_projection);
+		return;
+	}
+
+	const GLuint active_program = bindless ? bindless_program : program;
 	
 	// set program
-	glUseProgram(program);
+	glUseProgram(active_program);
+	set_uniforms(active_program);
+	GLuint depthOnlyLoc = glGetUniformLocation(active_program, "depth_only");
+
+	// bind vertex array
+	glBindVertexArray(object.vao);
+
+	for (int pass = 0; pass < resolution.pass_count(); pass++) {
+		begin_pass(active_program, pass);
+
+		if (depth_prepass) {
+			// depths of the hit points first, so the stepping loop shades each pixel only once
+			// this runs the stepping loop twice for every visible fragment, so it only pays off with a lot of overdraw
+			// (dense or overlapping instances) and is off by default
+			glUniform1i(depthOnlyLoc, true);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			draw_instances(bindless);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
+			// the conservative depth lets hidden fragments fail before the stepping loop
+			glDepthMask(GL_FALSE);
+			glDepthFunc(GL_LEQUAL);
+		}
+
+		glUniform1i(depthOnlyLoc, false);
+		draw_instances(bindless);
+
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+	}
+
+	// unbind
+	glBindVertexArray(0);
+	glUseProgram(0);
+
+	// to the window
+	resolution.end(view_projection);
+}
+
+void Scene::set_uniforms(GLuint shader_program) {
 	// get uniform locations and set uniform values
 	// vertex shader
-	GLuint worldViewMatrixLoc = glGetUniformLocation(program, "worldViewMatrix");
-	GLuint projectionMatrixLoc = glGetUniformLocation(program, "projectionMatrix");
+	GLuint viewMatrixLoc = glGetUniformLocation(shader_program, "viewMatrix");
+	GLuint projectionMatrixLoc = glGetUniformLocation(shader_program, "projectionMatrix");
+	GLuint uvTransformLoc = glGetUniformLocation(shader_program, "uvTransform");
+
+	GLuint objectDepthLoc = glGetUniformLocation(shader_program, "objectDepth");
+	GLuint uvToWorldLoc = glGetUniformLocation(shader_program, "uvToWorld");
 
-	glUniformMatrix4fv(worldViewMatrixLoc, 1, false,
-										 glm::value_ptr(camera.get_view_matrix() * worldMatrix));
+	glUniformMatrix4fv(viewMatrixLoc, 1, false,
+										 glm::value_ptr(camera.get_view_matrix()));
 	glUniformMatrix4fv(projectionMatrixLoc, 1, false,
 										 glm::value_ptr(camera.get_projection_matrix()));
+	glUniform4fv(uvTransformLoc, 1, glm::value_ptr(object.uv_transform));
+	glUniform1f(objectDepthLoc, object.depth);
+	glUniform1f(uvToWorldLoc, object.uv_to_world);
 
 	// fragment shader
-	GLuint coneStepsLoc = glGetUniformLocation(program, "cone_steps");
-	GLuint binaryStepsLoc = glGetUniformLocation(program, "binary_steps");
-	GLuint display_modeLoc = glGetUniformLocation(program, "display_mode");
-	GLboolean cell_max_traceLoc = glGetUniformLocation(program, "cell_max_trace");
-	GLboolean show_convergenceLoc = glGetUniformLocation(program, "show_convergence");
-	GLuint stepmapLoc = glGetUniformLocation(program, "stepmap");
-	GLuint texmapLoc = glGetUniformLocation(program, "texmap");
-	GLuint depthLoc = glGetUniformLocation(program, "depth");
+	GLuint coneStepsLoc = glGetUniformLocation(shader_program, "cone_steps");
+	GLuint binaryStepsLoc = glGetUniformLocation(shader_program, "binary_steps");
+	GLuint display_modeLoc = glGetUniformLocation(shader_program, "display_mode");
+	GLboolean cell_max_traceLoc = glGetUniformLocation(shader_program, "cell_max_trace");
+	GLboolean show_convergenceLoc = glGetUniformLocation(shader_program, "show_convergence");
+	GLboolean footprint_lodLoc = glGetUniformLocation(shader_program, "footprint_lod");
+	GLuint stepmapLoc = glGetUniformLocation(shader_program, "stepmap");
+	GLuint texmapLoc = glGetUniformLocation(shader_program, "texmap");
+	GLuint clipToUVBoundsLoc = glGetUniformLocation(shader_program, "clip_to_uv_bounds");
+	GLuint footprintScaleLoc = glGetUniformLocation(shader_program, "footprint_scale");
 
 	glUniform1i(coneStepsLoc, cone_steps);
 	glUniform1i(binaryStepsLoc, binary_steps);
 	glUniform1i(display_modeLoc, display_mode);
 	glUniform1i(cell_max_traceLoc, cell_max_trace);
 	glUniform1i(show_convergenceLoc, show_convergence);
-	glUniform1f(depthLoc, quad.depth);
+	glUniform1i(footprint_lodLoc, footprint_lod);
+	glUniform1i(clipToUVBoundsLoc, silhouettes && object.boundary_on_uv_bounds);
+	glUniform1f(footprintScaleLoc, resolution.footprint_scale());
 
-	// bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, quad.stepmapTex);
 	glUniform1i(stepmapLoc, 0);
-
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, quad.texmapTex);
 	glUniform1i(texmapLoc, 1);
+}
 
-	// bind vertex array
-	glBindVertexArray(quad.vao);
+void Scene::begin_pass(GLuint shader_program, int pass) {
+	// the interleaved passes move the projected scene onto the pixels they trace
+	const glm::mat4 projection = resolution.begin_pass(pass) * camera.get_projection_matrix();
+	glUniformMatrix4fv(glGetUniformLocation(shader_program, "projectionMatrix"), 1, false, glm::value_ptr(projection));
+}
 
-	// draw
-	glDrawArrays(GL_TRIANGLES, 0, 6);
+void Scene::draw_instances(bool bindless) {
+	if (bindless) {
+		// all instances with their own textures at once
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, handle_ssbo);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(draw_ranges.size()), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	} else {
+		// one call per batch of instances sharing texture arrays
+		for (size_t b = 0; b < batches.size(); b++) {
+			if (draw_ranges[b].count == 0) continue;
 
-	// unbind
-	glBindVertexArray(0);
-	glUseProgram(0);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture_arrays.array(batches[b].stepmap_class));
+
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, texture_arrays.array(batches[b].texmap_class));
+
+			glDrawElementsInstancedBaseInstance(GL_TRIANGLES, object.index_count, GL_UNSIGNED_INT, nullptr, draw_ranges[b].count, draw_ranges[b].first);
+		}
+	}
 }
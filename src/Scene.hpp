@@ -1,27 +1,130 @@
 #ifndef SCENE_HPP
 #define SCENE_HPP
 
+// STD
+#include <filesystem>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
 // Utils
 #include "ConeSteppingObject.hpp"
 #include "Camera.hpp"
 #include "Controls.hpp"
+#include "BindlessTextures.hpp"
+#include "ComputeStepping.hpp"
+#include "ResolutionScaler.hpp"
+#include "TextureArrays.hpp"
+
+// a placement of the object
+struct Instance {
+	glm::mat4 world = glm::mat4(1.0f);
+	float depth_scale = 1.0f; // multiplies the depth of the object
+	GLuint stepmap = 0; // 0 for the selected cone map
+	GLuint texmap = 0; // 0 for the selected texture
+};
+
+// the instances drawn, changed has to be set after editing them
+struct InstanceSet {
+	std::vector<Instance> instances = {Instance()};
+	bool changed = true;
+};
+
+// size x size instances side by side around the origin, for an object fitted to the quad
+std::vector<Instance> grid_instances(int size);
 
 class Scene {
-	// program
+	// programs
 	GLuint program;
+	GLuint bindless_program = 0; // 0 if bindless textures are not supported
+
+	// per instance attributes of the visible instances, in the order of the batches
+	GLuint instance_vbo;
+
+	struct InstanceAttributes {
+		glm::mat4 world; // locations 3 to 6, one column each
+		float depth_scale; // location 7
+		GLint layers[2]; // location 8, cone map and texture layer, or the batch twice with bindless textures
+	};
+
+	// the textures of the instances are drawn from layers of texture arrays
+	TextureArrays texture_arrays;
+
+	// runs of instances sharing texture arrays, or textures with bindless textures, each drawn at once
+	struct Batch {
+		int stepmap_class;
+		int texmap_class;
+		size_t begin; // range of sorted_attributes
+		size_t end;
+	};
+	std::vector<InstanceAttributes> sorted_attributes; // of all instances
+	std::vector<Batch> batches;
+
+	// visible instances of each batch after culling
+	struct DrawRange {
+		GLuint first;
+		GLsizei count;
+	};
+	std::vector<DrawRange> draw_ranges;
+
+	// with bindless textures, the instances sample their own textures through handles
+	// and all batches are drawn with one multi-draw
+	BindlessTextures bindless_textures;
+	GLuint handle_ssbo; // cone map and texture handle per batch
+	GLuint indirect_buffer; // draw commands
+
+	// stepping in compute shader tiles instead of the fragment shader
+	ComputeStepping compute_stepping;
+
+	// selected textures and path the instances were sorted with
+	GLuint sorted_stepmap = 0;
+	GLuint sorted_texmap = 0;
+	bool sorted_bindless = false;
+
+	// view and settings the visible instances were culled with
+	glm::mat4 culled_view_projection = glm::mat4(0.0f);
+	bool culled_with_culling = false;
+	float culled_depth = -1.0f;
+	bool cull_pending = true;
+
+	// what the previous frames were rendered with apart from the view, the resolution scaler reuses them until it changes
+	struct HistorySettings {
+		int cone_steps, binary_steps, display_mode;
+		bool cell_max_trace, show_convergence, footprint_lod, silhouettes, bindless, compute;
+		float depth;
+		GLuint stepmap, texmap;
+
+		bool operator==(const HistorySettings &) const = default;
+	};
+	HistorySettings history_settings = {};
+
+	// sorts the instances into batches
+	void sort_instances();
+	// uploads the instances of the batches that pass culling
+	void cull_instances(const glm::mat4 &view_projection);
+	bool is_visible(const InstanceAttributes &instance, const glm::mat4 &view_projection, const glm::vec3 &eye) const;
+	// sets the uniforms of the settings, the camera and the object, the program must be bound
+	void set_uniforms(GLuint shader_program);
+	// sets the viewport and projection of a pass of the resolution scaler, the program must be bound
+	void begin_pass(GLuint shader_program, int pass);
+	// issues the draws of the visible instances, the program and vertex array must be bound
+	void draw_instances(bool bindless);
 
 	// camera
 	Camera camera;
 
 public:
-	Scene();
+	// the object is the mesh if given and it can be loaded, otherwise a quad
+	Scene(const std::filesystem::path &mesh_path = {});
 	~Scene();
 	
 	// camera controls
 	Controls controls;
 	
 	// objects
-	ConeSteppingObject quad;
+	ConeSteppingObject object;
+	InstanceSet instances;
 
 	// rendering settings
 	int cone_steps = 128;
@@ -29,6 +132,23 @@ public:
 	int display_mode = 1;
 	bool cell_max_trace = false;
 	bool show_convergence = true;
+	bool footprint_lod = false; // coarse cone map levels are not conservative and can step past thin features
+	bool use_bindless = false; // only has an effect if bindless textures are supported
+	bool culling = true; // skip instances outside the view or facing away
+	bool depth_prepass = false; // render the depths of all instances before shading them
+	bool silhouettes = true; // discard rays leaving the sides of the height field volume, if the object allows it
+	// step in compute shader tiles, only has an effect if compute shaders are supported
+	// and the textures of the instances fit one texture array each (same size class), the fragment shader steps otherwise
+	bool use_compute = false;
+
+	// resolution the scene is rendered at, the window framebuffer size has to be passed on to it
+	ResolutionScaler resolution;
+
+	// instances drawn in the last frame
+	size_t visible_instances = 0;
+
+	bool bindless_supported() const { return bindless_program != 0; }
+	bool compute_supported() const { return compute_stepping.is_supported(); }
 
 	// rendering
 	void render();
@@ -0,0 +1,81 @@
+// STD
+#include <algorithm>
+
+#include "TextureArrays.hpp"
+
+TextureArrays::~TextureArrays() {
+	for (SizeClass &size_class : classes) {
+		glDeleteTextures(1, &size_class.array);
+	}
+}
+
+TextureLayer TextureArrays::layer_of(GLuint texture) {
+	if (texture == 0) return {};
+
+	auto found = texture_layers.find(texture);
+	if (found != texture_layers.end()) return found->second;
+
+	// properties deciding the size class
+	GLint width, height, levels, min_filter;
+	GLfloat max_anisotropy = 1.0f;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+	glGetTextureParameteriv(texture, GL_TEXTURE_MIN_FILTER, &min_filter);
+	glGetTextureParameterfv(texture, GL_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+
+	auto it = std::find_if(classes.begin(), classes.end(), [&](const SizeClass &c) {
+		return c.width == width && c.height == height && c.levels == levels &&
+			c.min_filter == min_filter && c.max_anisotropy == max_anisotropy;
+	});
+	if (it == classes.end()) {
+		classes.push_back({width, height, levels, min_filter, max_anisotropy});
+		it = classes.end() - 1;
+	}
+
+	SizeClass &size_class = *it;
+	if (size_class.layers == size_class.capacity) grow(size_class);
+
+	// copy every level into the new layer
+	const GLint layer = size_class.layers++;
+	for (GLint level = 0; level < levels; level++) {
+		glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0,
+				size_class.array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+				std::max(1, width >> level), std::max(1, height >> level), 1);
+	}
+
+	const TextureLayer result = {static_cast<int>(it - classes.begin()), layer};
+	texture_layers.emplace(texture, result);
+	return result;
+}
+
+GLuint TextureArrays::array(int size_class) const {
+	return size_class < 0 ? 0 : classes[size_class].array;
+}
+
+void TextureArrays::grow(SizeClass &size_class) {
+	const GLsizei capacity = std::max<GLsizei>(4, size_class.capacity * 2);
+
+	GLuint array;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+	glTextureStorage3D(array, size_class.levels, GL_RGBA8, size_class.width, size_class.height, capacity);
+
+	glTextureParameteri(array, GL_TEXTURE_MIN_FILTER, size_class.min_filter);
+	glTextureParameteri(array, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(array, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(array, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameterf(array, GL_TEXTURE_MAX_ANISOTROPY, size_class.max_anisotropy);
+
+	// move the layers already in use
+	if (size_class.layers > 0) {
+		for (GLint level = 0; level < size_class.levels; level++) {
+			glCopyImageSubData(size_class.array, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+					array, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+					std::max(1, size_class.width >> level), std::max(1, size_class.height >> level), size_class.layers);
+		}
+	}
+	glDeleteTextures(1, &size_class.array);
+
+	size_class.array = array;
+	size_class.capacity = capacity;
+}
@@ -0,0 +1,55 @@
+#ifndef TEXTURE_ARRAYS_HPP
+#define TEXTURE_ARRAYS_HPP
+
+// STD
+#include <unordered_map>
+#include <vector>
+
+// GLAD
+#include <glad/gl.h>
+
+// a texture copied into a layer of one of the arrays
+struct TextureLayer {
+	int size_class = -1; // -1 for no texture
+	GLint layer = 0;
+};
+
+// Copies of RGBA8 textures grouped into GL_TEXTURE_2D_ARRAYs by size class
+// (size, mip levels and filtering), so objects with different textures of the
+// same size class are drawn with the same bindings and select their layer per instance.
+class TextureArrays {
+public:
+	TextureArrays() = default;
+	~TextureArrays();
+
+	TextureArrays(const TextureArrays &) = delete;
+	TextureArrays &operator=(const TextureArrays &) = delete;
+
+	// the layer holding the texture, copied into its array on first use
+	TextureLayer layer_of(GLuint texture);
+
+	// the array of a size class, 0 for no texture
+	// the name changes when the array grows, so it should be looked up after adding textures
+	GLuint array(int size_class) const;
+
+private:
+	struct SizeClass {
+		GLsizei width;
+		GLsizei height;
+		GLsizei levels;
+		GLint min_filter;
+		GLfloat max_anisotropy;
+
+		GLuint array = 0;
+		GLsizei capacity = 0; // allocated layers
+		GLsizei layers = 0; // used layers
+	};
+
+	std::vector<SizeClass> classes;
+	std::unordered_map<GLuint, TextureLayer> texture_layers;
+
+	// reallocates the array with room for at least one more layer
+	void grow(SizeClass &size_class);
+};
+
+#endif
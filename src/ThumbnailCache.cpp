@@ -0,0 +1,213 @@
+// STD
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include "ThumbnailCache.hpp"
+#include "image_io.hpp"
+
+// key identifying a thumbnail, changes when the file is modified
+static std::optional<std::string> thumbnail_key(const std::filesystem::path &path, bool conemap) {
+	std::error_code ec;
+	auto mtime = std::filesystem::last_write_time(path, ec);
+	if (ec) return std::nullopt;
+
+	return path.string() + "|" + std::to_string(mtime.time_since_epoch().count()) + (conemap ? "|c" : "|t");
+}
+
+// stable file name for a key (FNV-1a)
+static std::string cache_file_name(const std::string &key) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (unsigned char c : key) {
+		hash = (hash ^ c) * 0x100000001b3ull;
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.rgba", static_cast<unsigned long long>(hash));
+	return name;
+}
+
+ThumbnailCache::ThumbnailCache() : slots(slot_count) {
+	// cache directory
+	if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+		cache_directory = std::filesystem::path(xdg) / "Conemap-renderer" / "thumbnails";
+	} else if (const char *home = std::getenv("HOME"); home && *home) {
+		cache_directory = std::filesystem::path(home) / ".cache" / "Conemap-renderer" / "thumbnails";
+	}
+
+	if (!cache_directory.empty()) {
+		std::error_code ec;
+		std::filesystem::create_directories(cache_directory, ec);
+		if (ec) {
+			std::fprintf(stderr, "Error: Could not create thumbnail cache directory %s.\n", cache_directory.c_str());
+			cache_directory.clear();
+		}
+	}
+
+	// atlas
+	glCreateTextures(GL_TEXTURE_2D, 1, &atlas);
+	glTextureStorage2D(atlas, 1, GL_RGBA8, atlas_size, atlas_size);
+	glTextureParameteri(atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// start worker thread
+	worker = std::jthread([this](std::stop_token stoken) {
+		// wait until a request is queued or stop is requested
+		while (std::optional<Request> request = request_queue.pop(stoken)) {
+			if (!result_queue.push(Result{request->slot, request->version, generate(*request)}, stoken)) break;
+		}
+	});
+}
+
+ThumbnailCache::~ThumbnailCache() {
+	worker.request_stop();
+	worker.join();
+
+	glDeleteTextures(1, &atlas);
+}
+
+const std::optional<std::string> &ThumbnailCache::key_of(const std::filesystem::path &path, bool conemap) {
+	const auto now = std::chrono::steady_clock::now();
+	auto [it, inserted] = keys.try_emplace(path.string() + (conemap ? "|c" : "|t"));
+	Key &key = it->second;
+	if (inserted || now - key.checked >= key_lifetime) {
+		key.key = thumbnail_key(path, conemap);
+		key.checked = now;
+	}
+	return key.key;
+}
+
+int ThumbnailCache::acquire_slot(const std::string &key) {
+	// least recently used slot, but never one that was shown this frame
+	int lru = 0;
+	for (int i = 1; i < slot_count; i++) {
+		if (slots[i].last_used < slots[lru].last_used) lru = i;
+	}
+	if (slots[lru].last_used == frame && !slots[lru].key.empty()) return -1;
+
+	slots_by_key.erase(slots[lru].key);
+	slots[lru].key = key;
+	slots[lru].version++;
+	slots[lru].ready = false;
+	slots_by_key.emplace(key, lru);
+
+	return lru;
+}
+
+std::optional<ThumbnailCache::Thumbnail> ThumbnailCache::get(const std::filesystem::path &path, bool conemap) {
+	const std::optional<std::string> &key = key_of(path, conemap);
+	if (!key) return std::nullopt;
+
+	auto it = slots_by_key.find(*key);
+	int slot;
+	if (it != slots_by_key.end()) {
+		slot = it->second;
+	} else {
+		slot = acquire_slot(*key);
+		if (slot < 0) return std::nullopt;
+
+		// never block the render thread, a full queue is retried next frame
+		if (!request_queue.try_push(Request{path, *key, conemap, slot, slots[slot].version})) {
+			slots_by_key.erase(slots[slot].key);
+			slots[slot].key.clear();
+			return std::nullopt;
+		}
+		requests_in_flight++;
+	}
+
+	slots[slot].last_used = frame;
+	if (!slots[slot].ready) return std::nullopt;
+
+	const float scale = 1.0f / slots_per_row;
+	const float x = (slot % slots_per_row) * scale;
+	const float y = (slot / slots_per_row) * scale;
+	return Thumbnail{static_cast<ImTextureID>(atlas), ImVec2(x, y), ImVec2(x + scale, y + scale)};
+}
+
+void ThumbnailCache::update() {
+	frame++;
+
+	while (std::optional<Result> result = result_queue.try_pop()) {
+		requests_in_flight--;
+		Slot &slot = slots[result->slot];
+		if (slot.version != result->version || result->pixels.empty()) continue; // evicted or failed
+
+		glTextureSubImage2D(atlas, 0,
+				(result->slot % slots_per_row) * thumbnail_size,
+				(result->slot / slots_per_row) * thumbnail_size,
+				thumbnail_size, thumbnail_size, GL_RGBA, GL_UNSIGNED_BYTE, result->pixels.data());
+		slot.ready = true;
+	}
+}
+
+std::vector<unsigned char> ThumbnailCache::generate(const Request &request) {
+	const size_t byte_size = thumbnail_size * thumbnail_size * 4;
+	std::vector<unsigned char> thumbnail(byte_size, 0);
+
+	// look in the disk cache first
+	std::filesystem::path cache_file;
+	if (!cache_directory.empty()) {
+		cache_file = cache_directory / cache_file_name(request.key);
+
+		std::ifstream file(cache_file, std::ios::in | std::ios::binary);
+		if (file.is_open() && file.read(reinterpret_cast<char *>(thumbnail.data()), byte_size)) {
+			return thumbnail;
+		}
+	}
+
+	int width, height, channels;
+	const std::vector<unsigned char> pixels = load_image_rgba(request.path, width, height, channels);
+	const unsigned char *data = pixels.data();
+	if (pixels.empty()) {
+		std::fprintf(stderr, "Error: Could not load thumbnail from %s.\n", request.path.c_str());
+		return {};
+	}
+
+	// fit the image into the thumbnail keeping its aspect ratio
+	const int size = std::max(width, height);
+	const int thumb_width = std::max(1, width * thumbnail_size / size);
+	const int thumb_height = std::max(1, height * thumbnail_size / size);
+	const int offset_x = (thumbnail_size - thumb_width) / 2;
+	const int offset_y = (thumbnail_size - thumb_height) / 2;
+
+	// box filter over the source pixels covered by each thumbnail pixel
+	for (int ty = 0; ty < thumb_height; ty++) {
+		const int y0 = ty * height / thumb_height;
+		const int y1 = std::max(y0 + 1, (ty + 1) * height / thumb_height);
+		for (int tx = 0; tx < thumb_width; tx++) {
+			const int x0 = tx * width / thumb_width;
+			const int x1 = std::max(x0 + 1, (tx + 1) * width / thumb_width);
+
+			uint64_t sum[4] = {0, 0, 0, 0};
+			for (int y = y0; y < y1; y++) {
+				const unsigned char *row = data + (static_cast<size_t>(y) * width) * 4;
+				for (int x = x0; x < x1; x++) {
+					for (int c = 0; c < 4; c++) sum[c] += row[x * 4 + c];
+				}
+			}
+			const uint64_t count = static_cast<uint64_t>(y1 - y0) * (x1 - x0);
+
+			unsigned char *out = thumbnail.data() + ((ty + offset_y) * thumbnail_size + tx + offset_x) * 4;
+			if (request.conemap) {
+				// cone maps store the height in the red channel
+				out[0] = out[1] = out[2] = static_cast<unsigned char>(sum[0] / count);
+				out[3] = 255;
+			} else {
+				for (int c = 0; c < 4; c++) out[c] = static_cast<unsigned char>(sum[c] / count);
+			}
+		}
+	}
+
+	// store in the disk cache
+	if (!cache_file.empty()) {
+		std::ofstream file(cache_file, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.write(reinterpret_cast<const char *>(thumbnail.data()), byte_size)) {
+			std::fprintf(stderr, "Error: Could not write thumbnail cache %s.\n", cache_file.c_str());
+		}
+	}
+
+	return thumbnail;
+}
@@ -0,0 +1,101 @@
+#ifndef THUMBNAIL_CACHE_HPP
+#define THUMBNAIL_CACHE_HPP
+
+// STD
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// GLAD
+#include <glad/gl.h>
+
+// ImGui
+#include "imgui.h"
+
+#include "MpmcQueue.hpp"
+
+// Small previews of textures and cone maps packed into a single atlas texture.
+// Previews are generated on a background thread and cached on disk keyed by
+// path and modification time, so they are only decoded at full resolution once.
+// Modification times are checked at most every key_lifetime per file, not on every get.
+class ThumbnailCache {
+public:
+	static constexpr int thumbnail_size = 64;
+	static constexpr int atlas_size = 1024;
+	static constexpr int slots_per_row = atlas_size / thumbnail_size;
+	static constexpr int slot_count = slots_per_row * slots_per_row;
+
+	struct Thumbnail {
+		ImTextureID texture;
+		ImVec2 uv0;
+		ImVec2 uv1;
+	};
+
+	ThumbnailCache();
+	~ThumbnailCache();
+
+	// returns the thumbnail if it is in the atlas, otherwise queues its generation
+	// cone maps are previewed by their heights
+	std::optional<Thumbnail> get(const std::filesystem::path &path, bool conemap);
+
+	// uploads finished thumbnails into the atlas, called once per frame on the render thread
+	void update();
+
+	// true while thumbnails are being generated, frames have to be rendered to show them
+	bool busy() const { return requests_in_flight > 0; }
+
+private:
+	struct Request {
+		std::filesystem::path path;
+		std::string key;
+		bool conemap;
+		int slot;
+		uint64_t version;
+	};
+
+	struct Result {
+		int slot;
+		uint64_t version;
+		std::vector<unsigned char> pixels; // thumbnail_size * thumbnail_size RGBA, empty on failure
+	};
+
+	struct Slot {
+		std::string key;
+		uint64_t version = 0; // incremented on reuse, so results for evicted thumbnails are dropped
+		uint64_t last_used = 0;
+		bool ready = false;
+	};
+
+	// thumbnail keys by path, so files are not checked every frame they are shown
+	struct Key {
+		std::optional<std::string> key; // nullopt if the file could not be checked
+		std::chrono::steady_clock::time_point checked;
+	};
+	static constexpr std::chrono::seconds key_lifetime{5};
+	std::unordered_map<std::string, Key> keys;
+
+	GLuint atlas = 0;
+
+	std::vector<Slot> slots;
+	std::unordered_map<std::string, int> slots_by_key;
+	uint64_t frame = 0;
+	size_t requests_in_flight = 0; // requests without a result taken by update
+
+	std::filesystem::path cache_directory;
+
+	// requests are bounded by the slots, every slot can have an evicted request in flight as well
+	MpmcQueue<Request> request_queue{2 * slot_count};
+	MpmcQueue<Result> result_queue{2 * slot_count};
+	std::jthread worker;
+
+	const std::optional<std::string> &key_of(const std::filesystem::path &path, bool conemap);
+	int acquire_slot(const std::string &key);
+	std::vector<unsigned char> generate(const Request &request);
+};
+
+#endif
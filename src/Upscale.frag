@@ -0,0 +1,38 @@
+#version 330 core
+
+// inputs from vertex shader
+in vec2 screenUV;
+
+// uniforms
+uniform sampler2D source;
+uniform vec2 sourceScale; // part of the source that was rendered to
+uniform bool edgeAware;
+
+// bilinear lookup that does not blend in texels outside the rendered part
+vec3 fetch(vec2 uv, vec2 texel) {
+	return texture(source, clamp(uv, 0.5f * texel, sourceScale - 0.5f * texel)).rgb;
+}
+
+void main() {
+	vec2 texel = 1.0f / vec2(textureSize(source, 0));
+	vec2 uv = screenUV * sourceScale;
+	vec3 color = fetch(uv, texel);
+
+	if (edgeAware) {
+		// sharpen the bilinear result against its neighbours in the source,
+		// less where the local contrast is high so edges do not ring (contrast adaptive sharpening)
+		vec3 north = fetch(uv + vec2(0.0f, texel.y), texel);
+		vec3 south = fetch(uv - vec2(0.0f, texel.y), texel);
+		vec3 east = fetch(uv + vec2(texel.x, 0.0f), texel);
+		vec3 west = fetch(uv - vec2(texel.x, 0.0f), texel);
+
+		vec3 minColor = min(color, min(min(north, south), min(east, west)));
+		vec3 maxColor = max(color, max(max(north, south), max(east, west)));
+		vec3 amplitude = sqrt(clamp(min(minColor, 1.0f - maxColor) / max(maxColor, 1e-4f), 0.0f, 1.0f));
+		vec3 weight = -0.125f * amplitude;
+
+		color = clamp((color + weight * (north + south + east + west)) / (1.0f + 4.0f * weight), 0.0f, 1.0f);
+	}
+
+	gl_FragColor = vec4(color, 1.0f);
+}
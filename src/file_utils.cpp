@@ -1,19 +1,18 @@
 // STD
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iostream>
 #include <string>
 #include <vector>
 
 // GLAD
 #include <glad/gl.h>
 
-// stb
-#ifndef STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_IMPLEMENTATION
-#endif
-#include "stb/stb_image.h"
-
 #include "file_utils.hpp"
+#include "image_io.hpp"
 
 std::string read_text_file(const std::filesystem::path &path) {
 	if(!std::filesystem::is_regular_file(path)) {
@@ -42,25 +41,139 @@ std::string read_text_file(const std::filesystem::path &path) {
 	return std::string(bytes.data(), bytesize);
 }
 
-void load_shader_from_file(const std::filesystem::path &path, const GLuint shader) {
-	const std::string shader_string = read_text_file(path);
+void load_shader_from_file(const std::filesystem::path &path, const GLuint shader, const std::string &defines) {
+	std::string shader_string = read_text_file(path);
+	if (!defines.empty()) {
+		const size_t line_end = shader_string.find('\n');
+		shader_string.insert(line_end == std::string::npos ? shader_string.size() : line_end + 1, defines);
+	}
 	const char *shader_text = shader_string.data();
 	const GLint shader_length = shader_string.length();
 	glShaderSource(shader, 1, &shader_text, &shader_length);
 	glCompileShader(shader);
 }
 
+// halves a cone map level (RGBA8: height, cone ratio, df/dx, df/dy)
+// a coarse texel takes the highest height and the narrowest cone of the texels it covers
+// this is a heuristic, not a bound: the cone of one texel is moved to the position and height of the coarse texel,
+// where it can cut into the surface next to it, so rays on coarse levels may step past thin features
+static std::vector<unsigned char> reduce_conemap_level(const unsigned char *src, int width, int height) {
+	const int dst_width = std::max(1, width / 2);
+	const int dst_height = std::max(1, height / 2);
+	std::vector<unsigned char> dst(static_cast<size_t>(dst_width) * dst_height * 4);
+
+	for (int y = 0; y < dst_height; y++) {
+		// odd sizes: the last coarse texel also covers the remaining fine row/column
+		const int y0 = 2 * y;
+		const int y1 = (y == dst_height - 1) ? height : std::min(height, y0 + 2);
+		for (int x = 0; x < dst_width; x++) {
+			const int x0 = 2 * x;
+			const int x1 = (x == dst_width - 1) ? width : std::min(width, x0 + 2);
+
+			unsigned char max_height = 0;
+			unsigned char min_cone = 255;
+			unsigned int sum_dx = 0;
+			unsigned int sum_dy = 0;
+			for (int sy = y0; sy < y1; sy++) {
+				for (int sx = x0; sx < x1; sx++) {
+					const unsigned char *texel = src + (static_cast<size_t>(sy) * width + sx) * 4;
+					max_height = std::max(max_height, texel[0]);
+					min_cone = std::min(min_cone, texel[1]);
+					sum_dx += texel[2];
+					sum_dy += texel[3];
+				}
+			}
+			const unsigned int count = (y1 - y0) * (x1 - x0);
+
+			unsigned char *texel = dst.data() + (static_cast<size_t>(y) * dst_width + x) * 4;
+			texel[0] = max_height;
+			texel[1] = min_cone;
+			texel[2] = static_cast<unsigned char>((sum_dx + count / 2) / count);
+			texel[3] = static_cast<unsigned char>((sum_dy + count / 2) / count);
+		}
+	}
+
+	return dst;
+}
+
+GLuint create_program(const std::filesystem::path &vertex_path, const std::filesystem::path &fragment_path, const std::string &fragment_defines) {
+	GLint success;
+	GLchar infoLog[512];
+
+// stages
+	// vertex
+	const GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+	load_shader_from_file(vertex_path, vertex_shader);
+	glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+			glGetShaderInfoLog(vertex_shader, 512, NULL, infoLog);
+			std::cerr << "Shader Compilation Error: " << infoLog << std::endl;
+	}
+
+	// fragment
+	const GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+	load_shader_from_file(fragment_path, fragment_shader, fragment_defines);
+
+	glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+			glGetShaderInfoLog(fragment_shader, 512, NULL, infoLog);
+			std::cerr << "Shader Compilation Error: " << infoLog << std::endl;
+	}
+
+// program
+	const GLuint program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	glLinkProgram(program);
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+			glGetProgramInfoLog(program, 512, NULL, infoLog);
+			std::cerr << "Program Linking Error: " << infoLog << std::endl;
+			glDeleteProgram(program);
+			return 0;
+	}
+	return program;
+}
+
+GLuint create_compute_program(const std::filesystem::path &path) {
+	GLint success;
+	GLchar infoLog[512];
+
+	const GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	load_shader_from_file(path, shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			std::cerr << "Shader Compilation Error: " << infoLog << std::endl;
+	}
+
+	const GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+			glGetProgramInfoLog(program, 512, NULL, infoLog);
+			std::cerr << "Program Linking Error: " << infoLog << std::endl;
+			glDeleteProgram(program);
+			return 0;
+	}
+	return program;
+}
+
 GLuint load_texture_from_file(const std::filesystem::path &path, bool conemap) {
 	if(!std::filesystem::is_regular_file(path)) {
 		std::fprintf(stderr, "Error: %s is not a file.\n", path.c_str());
 		return 0;
 	}
 
-	//stbi_set_flip_vertically_on_load(true); // OpenGL expects 0.0 at bottom
-
 	int width, height, channels;
-	unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 4);
-	if (!data) {
+	std::vector<unsigned char> data = load_image_rgba(path, width, height, channels);
+	if (data.empty()) {
 		std::fprintf(stderr, "Error: Could not load texture from %s.\n", path.c_str());
 		return 0;
 	}
@@ -68,18 +181,112 @@ GLuint load_texture_from_file(const std::filesystem::path &path, bool conemap) {
 		std::fprintf(stderr, "Error: Cone maps require 4 channels but %s only has %d.\n", path.c_str(), channels);
 		return 0;
 	}
-	
+
+	return create_texture(data.data(), width, height, conemap);
+}
+
+GLuint create_texture(const unsigned char *data, int width, int height, bool conemap) {
+	// full mip chain
+	const GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(std::max(width, height))));
+
 	GLuint textureID;
 	glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
 
-	glTextureStorage2D(textureID, 1, GL_RGBA8, width, height);
+	glTextureStorage2D(textureID, levels, GL_RGBA8, width, height);
 	glTextureSubImage2D(textureID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
 
-	glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	if (conemap) {
+		// coarser levels keep the highest heights and narrowest cones, averaging would flatten features away
+		// the first level is reduced straight from the data
+		std::vector<unsigned char> level;
+		int level_width = width;
+		int level_height = height;
+		for (GLsizei i = 1; i < levels; i++) {
+			level = reduce_conemap_level(i == 1 ? data : level.data(), level_width, level_height);
+			level_width = std::max(1, level_width / 2);
+			level_height = std::max(1, level_height / 2);
+			glTextureSubImage2D(textureID, i, 0, 0, level_width, level_height, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+		}
+
+		// levels are selected explicitly by the stepping loop
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+	} else {
+		glGenerateTextureMipmap(textureID);
+
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+		GLfloat max_anisotropy = 1.0f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+		glTextureParameterf(textureID, GL_TEXTURE_MAX_ANISOTROPY, std::min(max_anisotropy, 16.0f));
+	}
+
 	glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	stbi_image_free(data);
 	return textureID;
 }
+
+std::optional<FileKey> get_file_key(const std::filesystem::path &path) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		std::fprintf(stderr, "Error: Could not stat %s\n", path.c_str());
+		return std::nullopt;
+	}
+	return FileKey{st.st_dev, st.st_ino};
+}
+
+std::optional<uint64_t> hash_file_contents(const std::filesystem::path &path) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		fprintf(stderr, "Error: Could not open %s\n", path.c_str());
+		return std::nullopt;
+	}
+
+	// 64-bit multiply-rotate hash over 8 byte words, seeded with the FNV offset basis
+	const uint64_t prime = 0x100000001b3ull;
+	uint64_t hash = 0xcbf29ce484222325ull;
+	uint64_t size = 0;
+
+	std::vector<char> buffer(1 << 16);
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		std::streamsize count = file.gcount();
+		if (count <= 0) break;
+
+		// pad the last partial word with zeros
+		std::memset(buffer.data() + count, 0, (8 - count % 8) % 8);
+
+		for (std::streamsize i = 0; i < count; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, buffer.data() + i, 8);
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		size += count;
+	}
+
+	if (file.bad()) {
+		fprintf(stderr, "Error: Could not read %s\n", path.c_str());
+		return std::nullopt;
+	}
+
+	// the size distinguishes files differing only in trailing zeros
+	return (hash ^ size) * prime;
+}
+
+bool files_equal(const std::filesystem::path &a, const std::filesystem::path &b) {
+	std::ifstream file_a(a, std::ios::in | std::ios::binary);
+	std::ifstream file_b(b, std::ios::in | std::ios::binary);
+	if (!file_a.is_open() || !file_b.is_open()) return false;
+
+	std::vector<char> buffer_a(1 << 16);
+	std::vector<char> buffer_b(1 << 16);
+	while (file_a && file_b) {
+		file_a.read(buffer_a.data(), buffer_a.size());
+		file_b.read(buffer_b.data(), buffer_b.size());
+		const std::streamsize count = file_a.gcount();
+		if (count != file_b.gcount() || std::memcmp(buffer_a.data(), buffer_b.data(), count) != 0) return false;
+	}
+	return !file_a.bad() && !file_b.bad() && file_a.eof() && file_b.eof();
+}
@@ -2,14 +2,44 @@
 #define FILE_UTILS_H
 
 // STD
+#include <cstdint>
 #include <filesystem>
+#include <optional>
 #include <string>
 
+// POSIX
+#include <sys/stat.h>
+
 // GLAD
 #include <glad/gl.h>
 
 std::string read_text_file(const std::filesystem::path &path);
-void load_shader_from_file(const std::filesystem::path &path, const GLuint shader);
+void load_shader_from_file(const std::filesystem::path &path, const GLuint shader, const std::string &defines = ""); // defines are inserted after the #version line
+GLuint create_program(const std::filesystem::path &vertex_path, const std::filesystem::path &fragment_path, const std::string &fragment_defines = ""); // returns 0 if linking fails
+GLuint create_compute_program(const std::filesystem::path &path); // returns 0 if linking fails
 GLuint load_texture_from_file(const std::filesystem::path &path, bool conemap = false);
+GLuint create_texture(const unsigned char *data, int width, int height, bool conemap = false); // RGBA8
+
+// identity of a file on disk, equal for all paths leading to the same file
+struct FileKey {
+	dev_t device;
+	ino_t inode;
+
+	bool operator==(const FileKey &) const = default;
+};
+
+struct FileKeyHash {
+	size_t operator()(const FileKey &key) const {
+		return std::hash<dev_t>()(key.device) * 31 + std::hash<ino_t>()(key.inode);
+	}
+};
+
+std::optional<FileKey> get_file_key(const std::filesystem::path &path);
+
+// hash of the file contents (and size), equal for identical files at different paths
+std::optional<uint64_t> hash_file_contents(const std::filesystem::path &path);
+
+// true if both files can be read and have the same contents
+bool files_equal(const std::filesystem::path &a, const std::filesystem::path &b);
 
 #endif
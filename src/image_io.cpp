@@ -0,0 +1,600 @@
+// STD
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// SIMD
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// stb
+#ifndef STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#endif
+#include "stb/stb_image.h"
+
+#include "image_io.hpp"
+#include "parallel_for.hpp"
+
+static const unsigned char png_signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+static const size_t chunk_buffer_size = 1 << 16;
+static const size_t deflate_window = 1 << 15;
+static const size_t segment_size = 1 << 18; // filtered bytes per deflate stream when writing
+
+static uint32_t read_u32(const unsigned char *bytes) {
+	return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+static void write_u32(unsigned char *bytes, uint32_t value) {
+	bytes[0] = value >> 24;
+	bytes[1] = value >> 16;
+	bytes[2] = value >> 8;
+	bytes[3] = value;
+}
+
+static unsigned char paeth(unsigned char a, unsigned char b, unsigned char c) {
+	const int p = int(a) + int(b) - int(c);
+	const int pa = std::abs(p - int(a));
+	const int pb = std::abs(p - int(b));
+	const int pc = std::abs(p - int(c));
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+/* Filters */
+
+#ifdef __SSE2__
+// Every pixel depends on the one before it, so the SIMD filters process one 3 or 4 byte pixel per step
+// with all its channels at once, like libpng does.
+
+static __m128i load_pixel(const unsigned char *p, size_t bpp) {
+	uint32_t v = 0;
+	std::memcpy(&v, p, bpp);
+	return _mm_cvtsi32_si128(v);
+}
+
+static void store_pixel(unsigned char *p, __m128i v, size_t bpp) {
+	const uint32_t x = _mm_cvtsi128_si32(v);
+	std::memcpy(p, &x, bpp);
+}
+
+static void unfilter_sub_sse2(unsigned char *data, size_t stride, size_t bpp) {
+	__m128i a = _mm_setzero_si128();
+	for (size_t i = 0; i < stride; i += bpp) {
+		a = _mm_add_epi8(a, load_pixel(data + i, bpp));
+		store_pixel(data + i, a, bpp);
+	}
+}
+
+static void unfilter_average_sse2(unsigned char *data, const unsigned char *prior, size_t stride, size_t bpp) {
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i a = _mm_setzero_si128();
+	for (size_t i = 0; i < stride; i += bpp) {
+		const __m128i b = load_pixel(prior + i, bpp);
+		// _mm_avg_epu8 rounds up, the filter rounds down
+		const __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(load_pixel(data + i, bpp), average);
+		store_pixel(data + i, a, bpp);
+	}
+}
+
+static void unfilter_paeth_sse2(unsigned char *data, const unsigned char *prior, size_t stride, size_t bpp) {
+	const __m128i zero = _mm_setzero_si128();
+	auto abs16 = [zero](__m128i x) { return _mm_max_epi16(x, _mm_sub_epi16(zero, x)); };
+	auto select = [](__m128i mask, __m128i x, __m128i y) { return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y)); };
+
+	// 16 bit lanes so the distances do not overflow
+	__m128i a = zero;
+	__m128i c = zero;
+	for (size_t i = 0; i < stride; i += bpp) {
+		const __m128i b = _mm_unpacklo_epi8(load_pixel(prior + i, bpp), zero);
+
+		// distances of the prediction a + b - c to a, b and c
+		const __m128i pa_signed = _mm_sub_epi16(b, c);
+		const __m128i pb_signed = _mm_sub_epi16(a, c);
+		const __m128i pa = abs16(pa_signed);
+		const __m128i pb = abs16(pb_signed);
+		const __m128i pc = abs16(_mm_add_epi16(pa_signed, pb_signed));
+
+		const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+		const __m128i nearest = select(_mm_cmpeq_epi16(pa, smallest), a, select(_mm_cmpeq_epi16(pb, smallest), b, c));
+
+		// the high bytes stay zero
+		a = _mm_add_epi8(_mm_unpacklo_epi8(load_pixel(data + i, bpp), zero), nearest);
+		store_pixel(data + i, _mm_packus_epi16(a, a), bpp);
+		c = b;
+	}
+}
+#endif
+
+// reverses the filter of a row in place, prior is the previous unfiltered row
+static bool unfilter_row(unsigned char filter, unsigned char *data, const unsigned char *prior, size_t stride, size_t bpp) {
+#ifdef __SSE2__
+	const bool simd = bpp == 3 || bpp == 4;
+#endif
+
+	switch (filter) {
+		case 0: // None
+			break;
+		case 1: // Sub
+#ifdef __SSE2__
+			if (simd) {
+				unfilter_sub_sse2(data, stride, bpp);
+				break;
+			}
+#endif
+			for (size_t i = bpp; i < stride; i++) data[i] += data[i - bpp];
+			break;
+		case 2: // Up
+			for (size_t i = 0; i < stride; i++) data[i] += prior[i];
+			break;
+		case 3: // Average
+#ifdef __SSE2__
+			if (simd) {
+				unfilter_average_sse2(data, prior, stride, bpp);
+				break;
+			}
+#endif
+			for (size_t i = 0; i < bpp; i++) data[i] += prior[i] / 2;
+			for (size_t i = bpp; i < stride; i++) data[i] += (int(data[i - bpp]) + int(prior[i])) / 2;
+			break;
+		case 4: // Paeth
+#ifdef __SSE2__
+			if (simd) {
+				unfilter_paeth_sse2(data, prior, stride, bpp);
+				break;
+			}
+#endif
+			for (size_t i = 0; i < bpp; i++) data[i] += prior[i];
+			for (size_t i = bpp; i < stride; i++) data[i] += paeth(data[i - bpp], prior[i], prior[i - bpp]);
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+// filters a row with the filter that gives the smallest sum of absolute differences,
+// filtered receives the filter type and the filtered row, candidate is scratch space of stride bytes
+static void filter_row(const unsigned char *row, const unsigned char *prior, size_t stride, size_t bpp, unsigned char *filtered, unsigned char *candidate) {
+	uint64_t best_sum = UINT64_MAX;
+	for (int type = 0; type < 5; type++) {
+		for (size_t i = 0; i < stride; i++) {
+			const unsigned char a = i >= bpp ? row[i - bpp] : 0;
+			const unsigned char b = prior[i];
+			const unsigned char c = i >= bpp ? prior[i - bpp] : 0;
+			switch (type) {
+				case 0: candidate[i] = row[i]; break;
+				case 1: candidate[i] = row[i] - a; break;
+				case 2: candidate[i] = row[i] - b; break;
+				case 3: candidate[i] = row[i] - (int(a) + int(b)) / 2; break;
+				case 4: candidate[i] = row[i] - paeth(a, b, c); break;
+			}
+		}
+
+		uint64_t sum = 0;
+		for (size_t i = 0; i < stride; i++) sum += std::abs(int(static_cast<signed char>(candidate[i])));
+
+		if (sum < best_sum) {
+			best_sum = sum;
+			filtered[0] = type;
+			std::memcpy(filtered + 1, candidate, stride);
+		}
+	}
+}
+
+/* Reader */
+
+PngRowReader::PngRowReader(const std::filesystem::path &path, bool report_errors_)
+		: file(path, std::ios::in | std::ios::binary), report_errors(report_errors_) {
+	if (!file.is_open()) {
+		if (report_errors) std::fprintf(stderr, "Error: Could not open %s\n", path.c_str());
+		return;
+	}
+
+	open = read_header(path);
+	if (open) {
+		inflater = std::jthread([this](std::stop_token stop) { inflate_blocks(stop); });
+	}
+}
+
+PngRowReader::~PngRowReader() {
+	if (inflater.joinable()) {
+		inflater.request_stop();
+		inflater.join();
+	}
+	if (stream_initialized) inflateEnd(&stream);
+}
+
+bool PngRowReader::read_header(const std::filesystem::path &path) {
+	unsigned char signature[8];
+	if (!file.read(reinterpret_cast<char *>(signature), 8) || std::memcmp(signature, png_signature, 8) != 0) {
+		if (report_errors) std::fprintf(stderr, "Error: %s is not a PNG file.\n", path.c_str());
+		return false;
+	}
+
+	// chunks up to the first IDAT
+	bool has_header = false;
+	while (true) {
+		unsigned char chunk_header[8];
+		if (!file.read(reinterpret_cast<char *>(chunk_header), 8)) {
+			if (report_errors) std::fprintf(stderr, "Error: %s has no image data.\n", path.c_str());
+			return false;
+		}
+		const uint32_t length = read_u32(chunk_header);
+		const char *type = reinterpret_cast<const char *>(chunk_header + 4);
+
+		if (std::memcmp(type, "IHDR", 4) == 0) {
+			unsigned char ihdr[13];
+			if (length != 13 || !file.read(reinterpret_cast<char *>(ihdr), 13)) {
+				if (report_errors) std::fprintf(stderr, "Error: %s has an invalid header.\n", path.c_str());
+				return false;
+			}
+			file.ignore(4); // CRC
+
+			width = read_u32(ihdr);
+			height = read_u32(ihdr + 4);
+			bit_depth = ihdr[8];
+			const int color_type = ihdr[9];
+			const int interlace = ihdr[12];
+
+			switch (color_type) {
+				case 0: channels = 1; break;
+				case 2: channels = 3; break;
+				case 4: channels = 2; break;
+				case 6: channels = 4; break;
+				default: channels = 0; break;
+			}
+
+			if (!channels || (bit_depth != 8 && bit_depth != 16) || interlace != 0 || width <= 0 || height <= 0) {
+				if (report_errors) std::fprintf(stderr, "Error: %s uses an unsupported PNG format.\n", path.c_str());
+				return false;
+			}
+			has_header = true;
+		} else if (std::memcmp(type, "IDAT", 4) == 0) {
+			if (!has_header) {
+				if (report_errors) std::fprintf(stderr, "Error: %s has an invalid header.\n", path.c_str());
+				return false;
+			}
+			idat_remaining = length;
+			break;
+		} else {
+			file.ignore(std::streamsize(length) + 4); // data and CRC
+		}
+	}
+
+	if (inflateInit(&stream) != Z_OK) return false;
+	stream_initialized = true;
+
+	filter_bpp = channels * bit_depth / 8;
+	stride = static_cast<size_t>(width) * filter_bpp;
+	input.resize(chunk_buffer_size);
+	current.resize(stride + 1);
+	previous.assign(stride + 1, 0);
+
+	return true;
+}
+
+// IDAT chunks are consecutive, the first other chunk ends the image data
+bool PngRowReader::next_idat() {
+	while (idat_remaining == 0) {
+		unsigned char chunk_header[8];
+		file.ignore(4); // CRC of the previous chunk
+		if (!file.read(reinterpret_cast<char *>(chunk_header), 8) ||
+				std::memcmp(chunk_header + 4, "IDAT", 4) != 0) {
+			idat_done = true;
+			return false;
+		}
+		idat_remaining = read_u32(chunk_header);
+	}
+	return true;
+}
+
+bool PngRowReader::inflate_rows(unsigned char *data, size_t size) {
+	stream.next_out = data;
+	stream.avail_out = size;
+	while (stream.avail_out > 0) {
+		if (stream.avail_in == 0) {
+			if (idat_done || !next_idat()) return false;
+
+			const size_t count = std::min<size_t>(idat_remaining, input.size());
+			if (!file.read(reinterpret_cast<char *>(input.data()), count)) return false;
+			idat_remaining -= count;
+			stream.next_in = input.data();
+			stream.avail_in = count;
+		}
+
+		const int ret = inflate(&stream, Z_NO_FLUSH);
+		if (ret == Z_STREAM_END) {
+			if (stream.avail_out > 0) return false;
+			break;
+		}
+		if (ret != Z_OK && ret != Z_BUF_ERROR) return false;
+	}
+	return true;
+}
+
+// runs on the inflater thread, ahead of read_row by up to the capacity of the queue
+void PngRowReader::inflate_blocks(std::stop_token stop) {
+	const size_t row_size = stride + 1;
+	const int block_rows = std::max<int>(1, chunk_buffer_size / row_size);
+	for (int y = 0; y < height; y += block_rows) {
+		std::vector<unsigned char> data(std::min(block_rows, height - y) * row_size);
+		if (!inflate_rows(data.data(), data.size())) {
+			blocks.push({}, stop);
+			return;
+		}
+		if (!blocks.push(std::move(data), stop)) return;
+	}
+}
+
+bool PngRowReader::read_row(unsigned char *row) {
+	if (!open || rows_read >= height) return false;
+
+	// the filter byte and the row
+	if (block_offset == block.size()) {
+		std::optional<std::vector<unsigned char>> next = blocks.pop();
+		if (!next || next->empty()) {
+			open = false;
+			return false;
+		}
+		block = std::move(*next);
+		block_offset = 0;
+	}
+	std::memcpy(current.data(), block.data() + block_offset, current.size());
+	block_offset += current.size();
+
+	unsigned char *data = current.data() + 1;
+	if (!unfilter_row(current[0], data, previous.data() + 1, stride, filter_bpp)) return false;
+
+	if (bit_depth == 16) {
+		// keep the most significant byte
+		for (size_t i = 0; i < stride / 2; i++) row[i] = data[2 * i];
+	} else {
+		std::memcpy(row, data, stride);
+	}
+
+	std::swap(current, previous);
+	rows_read++;
+	return true;
+}
+
+/* Writer */
+
+PngRowWriter::PngRowWriter(const std::filesystem::path &path, int width_, int height_, int channels_)
+		: file(path, std::ios::out | std::ios::binary | std::ios::trunc),
+			width(width_), height(height_), channels(channels_) {
+	if (!file.is_open()) {
+		std::fprintf(stderr, "Error: Could not open %s\n", path.c_str());
+		return;
+	}
+
+	static const unsigned char color_types[5] = {0, 0, 4, 2, 6};
+	if (channels < 1 || channels > 4 || width <= 0 || height <= 0) return;
+
+	file.write(reinterpret_cast<const char *>(png_signature), 8);
+
+	unsigned char ihdr[13];
+	write_u32(ihdr, width);
+	write_u32(ihdr + 4, height);
+	ihdr[8] = 8; // bit depth
+	ihdr[9] = color_types[channels];
+	ihdr[10] = 0; // deflate
+	ihdr[11] = 0; // adaptive filtering
+	ihdr[12] = 0; // no interlace
+	if (!write_chunk("IHDR", ihdr, 13)) return;
+
+	stride = static_cast<size_t>(width) * channels;
+	segment_rows = std::max<int>(1, segment_size / (stride + 1));
+	batch_rows = segment_rows * std::max(1u, std::thread::hardware_concurrency());
+	previous.assign(stride, 0);
+
+	open = true;
+}
+
+bool PngRowWriter::write_chunk(const char *type, const unsigned char *data, size_t size) {
+	unsigned char header[8];
+	write_u32(header, size);
+	std::memcpy(header + 4, type, 4);
+
+	uLong crc = crc32(0, header + 4, 4);
+	crc = crc32(crc, data, size);
+	unsigned char footer[4];
+	write_u32(footer, crc);
+
+	file.write(reinterpret_cast<const char *>(header), 8);
+	file.write(reinterpret_cast<const char *>(data), size);
+	file.write(reinterpret_cast<const char *>(footer), 4);
+	return file.good();
+}
+
+// raw deflate of one segment, primed with the data before it so matches can reach back into it
+static bool deflate_segment(const std::vector<unsigned char> &data, const unsigned char *dictionary, size_t dictionary_size, std::vector<unsigned char> &output) {
+	z_stream stream{};
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+	if (dictionary_size) deflateSetDictionary(&stream, dictionary, dictionary_size);
+
+	output.resize(deflateBound(&stream, data.size()) + 16); // and the sync flush marker
+	stream.next_in = const_cast<unsigned char *>(data.data());
+	stream.avail_in = data.size();
+	stream.next_out = output.data();
+	stream.avail_out = output.size();
+
+	// a sync flush ends on a byte boundary without marking the last block, so the next segment can follow directly
+	const int ret = deflate(&stream, Z_SYNC_FLUSH);
+	const bool ok = ret == Z_OK && stream.avail_in == 0 && stream.avail_out > 0;
+	output.resize(stream.total_out);
+
+	deflateEnd(&stream);
+	return ok;
+}
+
+bool PngRowWriter::encode(const unsigned char *rows, int count) {
+	const size_t row_size = stride + 1;
+	const int segments = (count + segment_rows - 1) / segment_rows;
+	std::vector<std::vector<unsigned char>> filtered(segments);
+	std::vector<std::vector<unsigned char>> compressed(segments);
+	std::vector<uLong> checksums(segments);
+
+	// filtering only depends on the unfiltered rows
+	parallel_for(segments, 1, [&](size_t s, size_t) {
+		const int first = s * segment_rows;
+		const int n = std::min(segment_rows, count - first);
+		filtered[s].resize(n * row_size);
+		std::vector<unsigned char> candidate(stride);
+		for (int r = 0; r < n; r++) {
+			const unsigned char *row = rows + (first + r) * stride;
+			const unsigned char *prior = first + r == 0 ? previous.data() : row - stride;
+			filter_row(row, prior, stride, channels, filtered[s].data() + r * row_size, candidate.data());
+		}
+		checksums[s] = adler32(1, filtered[s].data(), filtered[s].size());
+	});
+
+	std::atomic<bool> failed = false;
+	parallel_for(segments, 1, [&](size_t s, size_t) {
+		const std::vector<unsigned char> &before = s == 0 ? dictionary : filtered[s - 1];
+		const size_t dictionary_size = std::min(before.size(), deflate_window);
+		if (!deflate_segment(filtered[s], before.data() + before.size() - dictionary_size, dictionary_size, compressed[s])) {
+			failed = true;
+		}
+	});
+	if (failed) {
+		std::fprintf(stderr, "Error: Could not compress PNG data.\n");
+		return false;
+	}
+
+	for (int s = 0; s < segments; s++) {
+		adler = adler32_combine(adler, checksums[s], filtered[s].size());
+
+		if (!zlib_header_written) {
+			// deflate with a 32 KiB window and default compression
+			static const unsigned char zlib_header[2] = {0x78, 0x9c};
+			compressed[s].insert(compressed[s].begin(), zlib_header, zlib_header + 2);
+			zlib_header_written = true;
+		}
+
+		if (!compressed[s].empty() && !write_chunk("IDAT", compressed[s].data(), compressed[s].size())) return false;
+	}
+
+	// the next batch continues from here
+	const std::vector<unsigned char> &last = filtered.back();
+	dictionary.insert(dictionary.end(), last.end() - std::min(last.size(), deflate_window), last.end());
+	if (dictionary.size() > deflate_window) {
+		dictionary.erase(dictionary.begin(), dictionary.end() - deflate_window);
+	}
+	previous.assign(rows + (count - 1) * stride, rows + count * stride);
+
+	return true;
+}
+
+bool PngRowWriter::write_rows(const unsigned char *rows, int count) {
+	if (!open || count < 0 || rows_written + count > height) return false;
+	rows_written += count;
+
+	while (count > 0) {
+		// whole batches are encoded straight from the caller's rows
+		if (pending_rows == 0 && count >= batch_rows) {
+			if (!encode(rows, batch_rows)) return false;
+			rows += batch_rows * stride;
+			count -= batch_rows;
+			continue;
+		}
+
+		const int n = std::min(count, batch_rows - pending_rows);
+		pending.insert(pending.end(), rows, rows + n * stride);
+		pending_rows += n;
+		rows += n * stride;
+		count -= n;
+
+		if (pending_rows == batch_rows) {
+			if (!encode(pending.data(), pending_rows)) return false;
+			pending.clear();
+			pending_rows = 0;
+		}
+	}
+
+	return true;
+}
+
+bool PngRowWriter::write_row(const unsigned char *row) {
+	return write_rows(row, 1);
+}
+
+bool PngRowWriter::finish() {
+	if (!open) return false;
+	open = false;
+
+	if (rows_written != height) {
+		std::fprintf(stderr, "Error: PNG has %d rows but only %d were written.\n", height, rows_written);
+		return false;
+	}
+
+	if (pending_rows && !encode(pending.data(), pending_rows)) return false;
+
+	// an empty last block with fixed codes ends the deflate data, the adler32 of all segments ends the zlib stream
+	unsigned char end[6] = {0x03, 0x00};
+	write_u32(end + 2, adler);
+	if (!write_chunk("IDAT", end, 6)) return false;
+
+	if (!write_chunk("IEND", nullptr, 0)) return false;
+
+	file.close();
+	return !file.fail();
+}
+
+bool write_png(const std::filesystem::path &path, const unsigned char *pixels, int width, int height, int channels) {
+	PngRowWriter writer(path, width, height, channels);
+	if (!writer.is_open()) return false;
+
+	return writer.write_rows(pixels, height) && writer.finish();
+}
+
+/* Loading */
+
+bool read_image_info(const std::filesystem::path &path, int &width, int &height, int &channels) {
+	return stbi_info(path.c_str(), &width, &height, &channels) != 0;
+}
+
+std::vector<unsigned char> load_image_rgba(const std::filesystem::path &path, int &width, int &height, int &channels) {
+	std::vector<unsigned char> pixels;
+
+	PngRowReader reader(path, false);
+	if (reader.is_open()) {
+		width = reader.get_width();
+		height = reader.get_height();
+		channels = reader.get_channels();
+		pixels.resize(static_cast<size_t>(width) * height * 4);
+
+		std::vector<unsigned char> row(static_cast<size_t>(width) * channels);
+		for (int y = 0; y < height; y++) {
+			unsigned char *dst = pixels.data() + static_cast<size_t>(y) * width * 4;
+			if (!reader.read_row(channels == 4 ? dst : row.data())) {
+				std::fprintf(stderr, "Error: Could not decode %s.\n", path.c_str());
+				return {};
+			}
+			if (channels == 4) continue;
+
+			for (int x = 0; x < width; x++) {
+				const unsigned char *src = row.data() + x * channels;
+				unsigned char *out = dst + x * 4;
+				out[0] = src[0];
+				out[1] = channels < 3 ? src[0] : src[1];
+				out[2] = channels < 3 ? src[0] : src[2];
+				out[3] = channels == 2 ? src[1] : 255;
+			}
+		}
+		return pixels;
+	}
+
+	// other formats and PNG variants the reader does not support
+	unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+	if (!data) return pixels;
+
+	pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(data);
+	return pixels;
+}
@@ -0,0 +1,127 @@
+#ifndef IMAGE_IO_HPP
+#define IMAGE_IO_HPP
+
+// STD
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+// zlib
+#include <zlib.h>
+
+#include "MpmcQueue.hpp"
+
+// Streaming PNG reader, decodes one row at a time so images larger than memory can be processed.
+// Supports non-interlaced 8 and 16 bit gray, gray + alpha, RGB and RGBA images,
+// 16 bit samples are reduced to 8 bits.
+// Decoding is pipelined: a background thread inflates blocks of rows while read_row reverses the filters.
+class PngRowReader {
+public:
+	explicit PngRowReader(const std::filesystem::path &path, bool report_errors = true);
+	~PngRowReader();
+
+	PngRowReader(const PngRowReader &) = delete;
+	PngRowReader &operator=(const PngRowReader &) = delete;
+
+	bool is_open() const { return open; }
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+	int get_channels() const { return channels; }
+
+	// decodes the next row into row (width * channels bytes)
+	bool read_row(unsigned char *row);
+
+private:
+	std::ifstream file;
+	bool open = false;
+	bool report_errors;
+
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	int bit_depth = 0;
+	int rows_read = 0;
+
+	// only used by the inflater thread once it is started
+	z_stream stream{};
+	bool stream_initialized = false;
+	uint32_t idat_remaining = 0; // bytes left in the current IDAT chunk
+	bool idat_done = false;
+	std::vector<unsigned char> input;
+
+	// blocks of filtered rows, an empty block reports an error
+	MpmcQueue<std::vector<unsigned char>> blocks{4};
+	std::vector<unsigned char> block;
+	size_t block_offset = 0;
+	std::jthread inflater;
+
+	size_t stride = 0; // bytes per row in the file, without the filter byte
+	size_t filter_bpp = 0; // bytes per complete pixel, used by the filters
+	std::vector<unsigned char> current;
+	std::vector<unsigned char> previous;
+
+	bool read_header(const std::filesystem::path &path);
+	bool next_idat();
+	bool inflate_rows(unsigned char *data, size_t size);
+	void inflate_blocks(std::stop_token stop);
+};
+
+// Streaming PNG writer, encodes rows as they arrive (8 bit gray, gray + alpha, RGB or RGBA).
+// Rows are collected into batches that are filtered and deflated in parallel,
+// one independent deflate stream per group of rows primed with the data before it,
+// so the output is a single valid zlib stream.
+class PngRowWriter {
+public:
+	PngRowWriter(const std::filesystem::path &path, int width, int height, int channels);
+
+	PngRowWriter(const PngRowWriter &) = delete;
+	PngRowWriter &operator=(const PngRowWriter &) = delete;
+
+	bool is_open() const { return open; }
+
+	// encodes the next row (width * channels bytes)
+	bool write_row(const unsigned char *row);
+
+	// encodes the next count consecutive rows
+	bool write_rows(const unsigned char *rows, int count);
+
+	// writes the remaining data, must be called after the last row
+	bool finish();
+
+private:
+	std::ofstream file;
+	bool open = false;
+
+	int width;
+	int height;
+	int channels;
+	size_t stride = 0;
+	int rows_written = 0;
+
+	int segment_rows = 1; // rows per deflate stream
+	int batch_rows = 1; // rows encoded together, one segment per thread
+
+	std::vector<unsigned char> pending; // rows waiting for a full batch
+	int pending_rows = 0;
+	std::vector<unsigned char> previous; // last encoded row
+	std::vector<unsigned char> dictionary; // end of the filtered data so far
+	uLong adler = 1; // adler32 of the filtered data so far
+	bool zlib_header_written = false;
+
+	bool encode(const unsigned char *rows, int count);
+	bool write_chunk(const char *type, const unsigned char *data, size_t size);
+};
+
+// writes a whole image
+bool write_png(const std::filesystem::path &path, const unsigned char *pixels, int width, int height, int channels);
+
+// reads the size and channels of an image in any format stb_image supports without decoding it
+bool read_image_info(const std::filesystem::path &path, int &width, int &height, int &channels);
+
+// Decodes an image to RGBA, supported PNG files with the pipelined reader and anything else with stb_image.
+// channels is set to the number of channels in the file, returns an empty vector on failure.
+std::vector<unsigned char> load_image_rgba(const std::filesystem::path &path, int &width, int &height, int &channels);
+
+#endif
@@ -19,9 +19,12 @@
 #include <imgui.h>
 
 // STD
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <getopt.h>
 
+#include "FrameStats.hpp"
 #include "Gui.hpp"
 #include "Scene.hpp"
 
@@ -30,12 +33,22 @@ static Gui *gui;
 static bool keyboard_to_imgui;
 static bool mouse_to_imgui;
 
+// Frames are only rendered while something may change.
+// Events render a few frames, ImGui needs them to settle hover states and window layouts,
+// and interleaved rendering needs one frame per interleaved pixel to trace all pixels again.
+static int frames_to_render = 3;
+static void request_frames() { frames_to_render = std::max(3, 2 + scene->resolution.interleave); }
+static constexpr double idle_wait = 0.5; // seconds between checks when nothing happens
+static constexpr double busy_wait = 1.0 / 30.0; // frame interval while background work shows progress
+static constexpr double max_delta_time = 0.1; // camera movement after an idle period
+
 static void error_callback(int error, const char *description) {
 	std::cerr << "Error: " << description << std::endl;
 }
 
 static void key_callback(GLFWwindow *window, int key, int scancode, int action,
 												 int mods) {
+	request_frames();
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GLFW_TRUE);
 
@@ -46,6 +59,7 @@ static void key_callback(GLFWwindow *window, int key, int scancode, int action,
 
 static void mouse_button_callback(GLFWwindow *window, int button, int action,
 																	int mods) {
+	request_frames();
 	if (!mouse_to_imgui) {
 		scene->controls.mouse_button_action(button, action, mods);
 	}
@@ -55,6 +69,7 @@ static double xpos;
 static double ypos;
 static void cursor_pos_callback(GLFWwindow *window, double _xpos,
 																double _ypos) {
+	request_frames();
 	if (!mouse_to_imgui) {
 
 		scene->controls.mouse_move_action(_xpos - xpos, _ypos - ypos);
@@ -65,6 +80,7 @@ static void cursor_pos_callback(GLFWwindow *window, double _xpos,
 
 static void scroll_callback(GLFWwindow *window, double xoffset,
 														double yoffset) {
+	request_frames();
 	if (!mouse_to_imgui) {
 		scene->controls.mouse_scroll_action(xoffset, yoffset);
 	}
@@ -72,11 +88,15 @@ static void scroll_callback(GLFWwindow *window, double xoffset,
 
 static void framebuffer_size_callback(GLFWwindow *window, int width,
 																			int height) {
+	request_frames();
+
 	// set viewport
 	glViewport(0, 0, width, height);
 
 	/// set camera aspect ratio
 	scene->controls.set_aspect(width / (float)height);
+
+	scene->resolution.resize(width, height);
 }
 
 
@@ -84,11 +104,25 @@ int main(int argc, char *argv[]) {
 	/* Parse command line arguments */
 	std::vector<std::filesystem::path> cone_maps;
 	std::vector<std::filesystem::path> textures;
+	std::vector<std::filesystem::path> generate_inputs;
+	std::filesystem::path mesh;
+	int grid_size = 1;
+	bool unlimited_frame_rate = false;
+	bool generate_analytic = false;
+	bool generate_depthmap = false;
+	bool generate_wrap = false;
 
 	// Define long options
 	const struct option long_options[] = {
 		{"cone-maps", required_argument, nullptr, 'c'},
 		{"textures", required_argument, nullptr, 't'},
+		{"generate", required_argument, nullptr, 'g'},
+		{"analytic", no_argument, nullptr, 'a'},
+		{"depth-map", no_argument, nullptr, 'd'},
+		{"wrap", no_argument, nullptr, 'w'},
+		{"mesh", required_argument, nullptr, 'm'},
+		{"grid", required_argument, nullptr, 'n'},
+		{"unlimited", no_argument, nullptr, 'u'},
 		{"help", no_argument, nullptr, 'h'},
 		{nullptr, 0, nullptr, 0}
 	};
@@ -97,14 +131,21 @@ int main(int argc, char *argv[]) {
 	int option_index = 0;
 
 	// Parse arguments
-	while ((opt = getopt_long(argc, argv, "c:t:h", long_options, &option_index)) != -1) {
+	while ((opt = getopt_long(argc, argv, "c:t:g:adwm:n:uh", long_options, &option_index)) != -1) {
 		switch (opt) {
 		case 'h':
-			std::cout << "Usage: " << argv[0] << " [-c CONE MAP...] [-t TEXTURE...]\n"
+			std::cout << "Usage: " << argv[0] << " [-c CONE MAP...] [-t TEXTURE...] [-g HEIGHT MAP... [-a] [-d] [-w]] [-m MESH] [-n SIZE] [-u]\n"
 				"Options:\n"
 				"  -h, --help             \tproduce help message\n"
 				"  -c, --cone-maps FILE...\tinput cone maps\n"
-				"  -t, --textures FILE... \tinput color textures\n";
+				"  -t, --textures FILE... \tinput color textures\n"
+				"  -g, --generate FILE... \tgenerate cone maps from height maps\n"
+				"  -a, --analytic         \tuse analytic instead of discrete generation\n"
+				"  -d, --depth-map        \tgeneration inputs are depth maps\n"
+				"  -w, --wrap             \tgenerate tileable cone maps\n"
+				"  -m, --mesh FILE        \trender a Wavefront OBJ mesh instead of a quad\n"
+				"  -n, --grid SIZE        \trender SIZE x SIZE instances of the object\n"
+				"  -u, --unlimited        \trender continuously instead of only on changes\n";
 			exit(0);
 			break;
 
@@ -123,6 +164,38 @@ int main(int argc, char *argv[]) {
 				textures.emplace_back(argv[optind++]);
 			}
 			break;
+
+		case 'g':
+			generate_inputs.emplace_back(optarg);
+			// Collect all non-option arguments after -g or --generate
+			while (optind < argc && argv[optind][0] != '-') {
+				generate_inputs.emplace_back(argv[optind++]);
+			}
+			break;
+
+		case 'a':
+			generate_analytic = true;
+			break;
+
+		case 'd':
+			generate_depthmap = true;
+			break;
+
+		case 'w':
+			generate_wrap = true;
+			break;
+
+		case 'm':
+			mesh = optarg;
+			break;
+
+		case 'n':
+			grid_size = std::atoi(optarg);
+			break;
+
+		case 'u':
+			unlimited_frame_rate = true;
+			break;
 		}
 	}
 
@@ -152,7 +225,11 @@ int main(int argc, char *argv[]) {
 	gladLoadGL(glfwGetProcAddress);
 
 	/* Create scene */
-	scene = new Scene();
+	scene = new Scene(mesh);
+
+	int framebuffer_width, framebuffer_height;
+	glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+	scene->resolution.resize(framebuffer_width, framebuffer_height);
 
 	/* Setup input callbacks */
 	// only after scene creation as these relay input to scene
@@ -164,6 +241,12 @@ int main(int argc, char *argv[]) {
 
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
+	// events only ImGui handles, its callbacks chain to these
+	glfwSetCharCallback(window, [](GLFWwindow *, unsigned int) { request_frames(); });
+	glfwSetWindowFocusCallback(window, [](GLFWwindow *, int) { request_frames(); });
+	glfwSetCursorEnterCallback(window, [](GLFWwindow *, int) { request_frames(); });
+	glfwSetWindowRefreshCallback(window, [](GLFWwindow *) { request_frames(); });
+
 	/* Start ImGui*/
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -173,30 +256,48 @@ int main(int argc, char *argv[]) {
 	ImGui_ImplOpenGL3_Init();
 
 	/* Create gui */
-	gui = new Gui(scene->cone_steps, scene->binary_steps, scene->display_mode, scene->cell_max_trace, scene->show_convergence, scene->quad, cone_maps, textures);
+	gui = new Gui(scene->cone_steps, scene->binary_steps, scene->display_mode, scene->cell_max_trace, scene->show_convergence, scene->footprint_lod, scene->silhouettes, scene->use_bindless, scene->bindless_supported(), scene->use_compute, scene->compute_supported(), scene->culling, scene->depth_prepass, scene->visible_instances, scene->resolution, scene->object, scene->instances, cone_maps, textures);
+	gui->generate_cone_maps(generate_inputs, generate_analytic, generate_depthmap, generate_wrap);
+	gui->set_grid_size(grid_size);
+	gui->unlimited_frame_rate = unlimited_frame_rate;
 
-	static std::queue<double> frame_times;
-	frame_times.push(glfwGetTime());
+	// frame times exclude the time spent waiting for events
+	FrameStats frame_stats;
+	double frame_start = glfwGetTime();
+	double waited = 0.0; // since frame_start
+	bool first_frame = true;
 
 	/* Loop until the user closes the window */
 	while (!glfwWindowShouldClose(window)) {
-		// calculate delta time
-		double now = glfwGetTime();
-		double delta_time = now - frame_times.back();
-		
-		// calculate FPS
-		while (frame_times.size() > 1 && frame_times.front() < now - 1) frame_times.pop(); // remove frame times outsied 1 sec window
-		frame_times.push(now); // add new time
-		double fps = frame_times.size() / (frame_times.back() - frame_times.front());
-
 		/* Poll for and process events */
 
 		// see if imgui captures events
 		keyboard_to_imgui = io.WantCaptureKeyboard;
 		mouse_to_imgui = io.WantCaptureMouse;
 
-		// execute callback functions as needed
-		glfwPollEvents();
+		// execute callback functions as needed, sleep until there are some if nothing changes
+		auto frame_needed = [&]() {
+			return gui->unlimited_frame_rate || frames_to_render > 0 || scene->controls.is_moving();
+		};
+		if (frame_needed()) {
+			glfwPollEvents();
+		} else {
+			const double wait_start = glfwGetTime();
+			glfwWaitEventsTimeout(gui->busy() ? busy_wait : idle_wait);
+			waited += glfwGetTime() - wait_start;
+			if (!frame_needed() && !gui->busy()) continue;
+		}
+		frames_to_render = std::max(0, frames_to_render - 1);
+
+		// calculate delta time
+		double now = glfwGetTime();
+		double delta_time = std::min(now - frame_start, max_delta_time);
+
+		// record the previous frame
+		if (!first_frame) frame_stats.add(now - frame_start - waited);
+		first_frame = false;
+		frame_start = now;
+		waited = 0.0;
 
 		/* Render ImGui */
 		ImGui_ImplOpenGL3_NewFrame();
@@ -205,7 +306,7 @@ int main(int argc, char *argv[]) {
 
 		ImGui::NewFrame();
 		/* Compose ImGui */
-		gui->compose(fps);
+		gui->compose(frame_stats);
 
 		ImGui::Render();
 
@@ -0,0 +1,123 @@
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Helper threads started on first use and kept for the lifetime of the process,
+// so a parallel loop only costs a wake up instead of creating and joining threads.
+// One loop uses the pool at a time, the others (and loops nested in a loop body) run on their calling thread.
+class WorkerPool {
+	std::vector<std::jthread> helpers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	void (*job)(void *) = nullptr;
+	void *job_context = nullptr;
+	size_t open_slots = 0; // helpers still allowed to join the job
+	size_t running = 0; // helpers in the job
+	bool stopping = false;
+
+	std::atomic<bool> busy = false; // claimed by the loop using the pool, also by nested loops of its own thread
+
+	WorkerPool() {
+		const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned i = 1; i < cores; i++) {
+			helpers.emplace_back([this]() {
+				std::unique_lock<std::mutex> lock(mutex);
+				while (true) {
+					wake.wait(lock, [this]() { return stopping || open_slots > 0; });
+					if (stopping) return;
+					open_slots--;
+					running++;
+					void (*run)(void *) = job;
+					void *context = job_context;
+					lock.unlock();
+					run(context);
+					lock.lock();
+					if (--running == 0) done.notify_all();
+				}
+			});
+		}
+	}
+
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		helpers.clear(); // joins before the members they use are destroyed
+	}
+
+public:
+	static WorkerPool &get() {
+		static WorkerPool pool;
+		return pool;
+	}
+
+	size_t helper_count() const { return helpers.size(); }
+
+	// runs work on the calling thread and up to max_helpers helpers, returns when all of them returned
+	// work must return once there is nothing left to do, helpers may join after the others finished
+	template <typename Work>
+	void run(size_t max_helpers, Work &work) {
+		if (max_helpers == 0 || helpers.empty() || busy.exchange(true, std::memory_order_acquire)) {
+			work();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = [](void *context) { (*static_cast<Work *>(context))(); };
+			job_context = &work;
+			open_slots = std::min(max_helpers, helpers.size());
+		}
+		wake.notify_all();
+
+		work();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			open_slots = 0; // helpers that did not wake up yet have nothing to do
+			done.wait(lock, [this]() { return running == 0; });
+			job = nullptr;
+			job_context = nullptr;
+		}
+		busy.store(false, std::memory_order_release);
+	}
+};
+
+// Runs body(begin, end) for consecutive chunks of [0, count) on up to one thread per core, the calling thread included.
+// Chunks are handed out as threads become free, so uneven work is balanced.
+// A single chunk runs on the calling thread without waking the pool.
+// Returns when all chunks are done, body must not throw.
+template <typename Body>
+void parallel_for(size_t count, size_t chunk_size, const Body &body) {
+	chunk_size = std::max<size_t>(chunk_size, 1);
+	const size_t chunks = (count + chunk_size - 1) / chunk_size;
+	if (chunks == 0) return;
+	if (chunks == 1) {
+		body(0, count);
+		return;
+	}
+
+	std::atomic<size_t> next = 0;
+	auto work = [&]() {
+		for (size_t chunk = next++; chunk < chunks; chunk = next++) {
+			const size_t begin = chunk * chunk_size;
+			body(begin, std::min(count, begin + chunk_size));
+		}
+	};
+
+	WorkerPool::get().run(chunks - 1, work);
+}
+
+#endif
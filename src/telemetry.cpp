@@ -0,0 +1,75 @@
+// STD
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+// POSIX
+#include <sys/resource.h>
+#include <time.h>
+
+#include "telemetry.hpp"
+
+double thread_cpu_seconds() {
+	timespec t;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) != 0) return 0.0;
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+double process_cpu_seconds() {
+	timespec t;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t) != 0) return 0.0;
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+bool reset_peak_rss() {
+	// "5" resets the high water mark of the resident set size
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	return clear_refs.is_open() && (clear_refs << "5").flush().good();
+}
+
+size_t peak_rss_bytes() {
+	// the high water mark follows resets, ru_maxrss does not
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.starts_with("VmHWM:")) {
+			return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024; // kB
+		}
+	}
+
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+std::string json_string(const std::string &s) {
+	std::string out = "\"";
+	for (unsigned char c : s) {
+		switch (c) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (c < 0x20) {
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					out += escaped;
+				} else {
+					out += c;
+				}
+		}
+	}
+	return out + "\"";
+}
+
+std::filesystem::path state_directory() {
+	if (const char *xdg = std::getenv("XDG_STATE_HOME"); xdg && *xdg) {
+		return std::filesystem::path(xdg) / "Conemap-renderer";
+	} else if (const char *home = std::getenv("HOME"); home && *home) {
+		return std::filesystem::path(home) / ".local" / "state" / "Conemap-renderer";
+	}
+	return {};
+}
@@ -0,0 +1,27 @@
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+// STD
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+// CPU time used by the calling thread, in seconds
+double thread_cpu_seconds();
+
+// CPU time used by all threads of the process, in seconds
+double process_cpu_seconds();
+
+// resets the peak resident set size of the process, returns false where that is not supported (Linux only)
+bool reset_peak_rss();
+
+// peak resident set size of the process in bytes, since the last successful reset
+size_t peak_rss_bytes();
+
+// a JSON string literal, quotes included
+std::string json_string(const std::string &s);
+
+// directory for logs, $XDG_STATE_HOME/Conemap-renderer or ~/.local/state/Conemap-renderer, empty if there is none
+std::filesystem::path state_directory();
+
+#endif
@@ -0,0 +1,323 @@
+// STD
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// POSIX
+#include <unistd.h>
+
+// Cone map generation
+#include "conemap.hpp"
+
+#include "image_io.hpp"
+#include "tiled_generation.hpp"
+
+// removes the scratch directory however generation ends
+// runs on a worker thread, so failures are reported through created instead of exceptions
+struct ScratchDirectory {
+	std::filesystem::path path;
+	bool created = false;
+
+	ScratchDirectory() {
+		static std::atomic<int> counter = 0;
+		std::error_code ec;
+		const std::filesystem::path temp = std::filesystem::temp_directory_path(ec);
+		if (ec) {
+			std::fprintf(stderr, "Error: Could not find the temporary directory: %s\n", ec.message().c_str());
+			return;
+		}
+		path = temp / ("conemap-tiles-" + std::to_string(getpid()) + "-" + std::to_string(counter++));
+		std::filesystem::create_directories(path, ec);
+		if (ec) {
+			std::fprintf(stderr, "Error: Could not create %s: %s\n", path.c_str(), ec.message().c_str());
+			return;
+		}
+		created = true;
+	}
+
+	~ScratchDirectory() {
+		if (!created) return;
+		std::error_code ec;
+		std::filesystem::remove_all(path, ec);
+	}
+};
+
+// rows of the input, streamed from the PNG files PngRowReader supports
+// other formats (JPEG, palette PNGs, ...) are decoded whole to RGBA with stb_image and handed out row by row
+class InputRows {
+public:
+	explicit InputRows(const std::filesystem::path &path_) : path(path_) {
+		png = std::make_unique<PngRowReader>(path, false);
+		if (png->is_open()) {
+			width = png->get_width();
+			height = png->get_height();
+			channels = png->get_channels();
+			return;
+		}
+		png.reset();
+
+		int file_channels;
+		std::vector<unsigned char> decoded = load_image_rgba(path, width, height, file_channels);
+		if (decoded.empty()) {
+			std::fprintf(stderr, "Error: Could not decode %s.\n", path.c_str());
+			return;
+		}
+		pixels = std::make_shared<const std::vector<unsigned char>>(std::move(decoded));
+		channels = 4;
+	}
+
+	// another pass over the rows from the top, without decoding a decoded image again
+	std::unique_ptr<InputRows> restart() const {
+		if (!pixels) return std::make_unique<InputRows>(path);
+		auto rows = std::unique_ptr<InputRows>(new InputRows(*this));
+		rows->next_row = 0;
+		return rows;
+	}
+
+	bool is_open() const { return png || pixels; }
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+	int get_channels() const { return channels; }
+
+	// the next row, width * channels bytes
+	bool read_row(unsigned char *row) {
+		if (png) return png->read_row(row);
+		if (!pixels || next_row >= height) return false;
+		const size_t stride = static_cast<size_t>(width) * 4;
+		std::memcpy(row, pixels->data() + next_row++ * stride, stride);
+		return true;
+	}
+
+private:
+	std::filesystem::path path;
+	std::unique_ptr<PngRowReader> png;
+	std::shared_ptr<const std::vector<unsigned char>> pixels;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	int next_row = 0;
+
+	InputRows(const InputRows &other)
+			: path(other.path), pixels(other.pixels), width(other.width), height(other.height), channels(other.channels) {}
+};
+
+// converts a row to 8 bit heights the same way stb_image converts to gray
+static void to_gray(const unsigned char *row, unsigned char *gray, int width, int channels) {
+	for (int x = 0; x < width; x++) {
+		const unsigned char *pixel = row + x * channels;
+		gray[x] = channels < 3 ? pixel[0] : static_cast<unsigned char>((pixel[0] * 77 + pixel[1] * 150 + pixel[2] * 29) >> 8);
+	}
+}
+
+GeneratedConeMap generate_tiled(const std::filesystem::path &output_directory, const std::filesystem::path &input, bool analytic, bool depthmap, int tile_size, int overlap, bool wrap, std::stop_token stop, const std::function<void(float)> &progress, bool in_memory) {
+	InputRows reader(input);
+	if (!reader.is_open()) return {};
+
+	const int width = reader.get_width();
+	const int height = reader.get_height();
+	const int channels = reader.get_channels();
+	if (tile_size <= 0) tile_size = std::max(width, height);
+	overlap = std::max(1, overlap); // the clamp below needs room for a cone beside every texel
+	if (wrap) overlap = std::min({overlap, width, height}); // the overlap may wrap around the image once
+
+	std::error_code ec;
+	ScratchDirectory scratch;
+	if (!scratch.created) return {};
+	const std::filesystem::path tile_input = scratch.path / "tile.png";
+
+	// input rows of the current band of tiles and its overlap
+	std::deque<std::vector<unsigned char>> rows;
+	int first_row = 0; // index of rows.front()
+	std::vector<unsigned char> row(static_cast<size_t>(width) * channels);
+
+	// when wrapping, the rows above the image are its last rows and the rows below it are its first rows
+	std::vector<std::vector<unsigned char>> head; // first overlap rows, kept while streaming
+	std::vector<std::vector<unsigned char>> tail; // last overlap rows, read ahead in a separate pass
+	if (wrap && overlap > 0) {
+		std::unique_ptr<InputRows> tail_reader = reader.restart();
+		for (int y = 0; y < height; y++) {
+			if (!tail_reader->read_row(row.data())) {
+				std::fprintf(stderr, "Error: Could not read %s.\n", input.c_str());
+				return {};
+			}
+			if (y >= height - overlap) {
+				tail.emplace_back(width);
+				to_gray(row.data(), tail.back().data(), width, channels);
+			}
+		}
+	}
+
+	auto source_row = [&](int y) -> const unsigned char * {
+		if (y < 0) return tail[y + overlap].data();
+		if (y >= height) return head[y - height].data();
+		return rows[y - first_row].data();
+	};
+
+	// the whole output when it is kept in memory, otherwise the output rows of the current band of tiles
+	const size_t output_bytes = static_cast<size_t>(width) * height * 4;
+	const bool keep_in_memory = in_memory && output_bytes <= max_in_memory_cone_map_bytes;
+	std::shared_ptr<std::vector<unsigned char>> image;
+	std::vector<unsigned char> band;
+	if (keep_in_memory) {
+		image = std::make_shared<std::vector<unsigned char>>(output_bytes);
+	} else {
+		band.resize(static_cast<size_t>(width) * tile_size * 4);
+	}
+	std::vector<unsigned char> tile_row;
+
+	std::filesystem::path output;
+	std::unique_ptr<PngRowWriter> writer;
+
+	// a stopped generation leaves no partial output behind
+	auto fail = [&]() -> GeneratedConeMap {
+		if (writer) {
+			writer.reset();
+			std::filesystem::remove(output, ec);
+		}
+		return {};
+	};
+
+	const int tiles_x = (width + tile_size - 1) / tile_size;
+	const int tiles_y = (height + tile_size - 1) / tile_size;
+	int tiles_done = 0;
+
+	for (int band_y = 0; band_y < height; band_y += tile_size) {
+		const int band_height = std::min(tile_size, height - band_y);
+		unsigned char *band_data = keep_in_memory ? image->data() + static_cast<size_t>(band_y) * width * 4 : band.data();
+		const int y0 = wrap ? band_y - overlap : std::max(0, band_y - overlap);
+		const int y1 = wrap ? band_y + band_height + overlap : std::min(height, band_y + band_height + overlap);
+
+		// stream in the rows needed by this band and drop the ones above it
+		while (first_row + static_cast<int>(rows.size()) < std::min(y1, height)) {
+			if (!reader.read_row(row.data())) {
+				std::fprintf(stderr, "Error: Could not read %s.\n", input.c_str());
+				return fail();
+			}
+			rows.emplace_back(width);
+			to_gray(row.data(), rows.back().data(), width, channels);
+			if (wrap && static_cast<int>(head.size()) < overlap) head.push_back(rows.back());
+		}
+		while (first_row < std::max(y0, 0)) {
+			rows.pop_front();
+			first_row++;
+		}
+
+		for (int band_x = 0; band_x < width; band_x += tile_size) {
+			if (stop.stop_requested()) return fail();
+
+			const int band_width = std::min(tile_size, width - band_x);
+			const int x0 = wrap ? band_x - overlap : std::max(0, band_x - overlap);
+			const int x1 = wrap ? band_x + band_width + overlap : std::min(width, band_x + band_width + overlap);
+			const int tile_width = x1 - x0;
+			const int tile_height = y1 - y0;
+
+			// tile with its overlap
+			std::vector<unsigned char> tile(static_cast<size_t>(tile_width) * tile_height);
+			for (int y = y0; y < y1; y++) {
+				const unsigned char *src = source_row(y);
+				unsigned char *dst = tile.data() + static_cast<size_t>(y - y0) * tile_width;
+				for (int x = x0; x < x1; x++) {
+					dst[x - x0] = src[(x % width + width) % width];
+				}
+			}
+			if (!write_png(tile_input, tile.data(), tile_width, tile_height, 1)) {
+				std::fprintf(stderr, "Error: Could not write tile of %s.\n", input.c_str());
+				return fail();
+			}
+
+			std::filesystem::path tile_output = analytic
+				? conemap::analytic(scratch.path, tile_input, depthmap)
+				: conemap::discrete(scratch.path, tile_input, depthmap);
+			if (tile_output.empty()) return fail();
+
+			// name the output the way the generator names its outputs
+			if (output.empty()) {
+				const std::string tile_name = tile_output.filename().string();
+				const std::string suffix = tile_name.starts_with("tile") ? tile_name.substr(4) : "_conemap.png";
+				output = output_directory / (input.stem().string() + suffix);
+
+				if (!keep_in_memory) {
+					writer = std::make_unique<PngRowWriter>(output, width, height, 4);
+					if (!writer->is_open()) return fail();
+				}
+			}
+
+			PngRowReader tile_reader(tile_output);
+			if (!tile_reader.is_open() || tile_reader.get_width() != tile_width ||
+					tile_reader.get_height() != tile_height || tile_reader.get_channels() != 4) {
+				std::fprintf(stderr, "Error: Unexpected cone map generated for tile of %s.\n", input.c_str());
+				return fail();
+			}
+
+			// cone ratios are relative to the texture size, the tile spans a different part of its texture
+			// the map stores the square root of the ratio
+			const float cone_scale = std::sqrt(static_cast<float>(std::max(tile_width, tile_height)) / std::max(width, height));
+
+			// the generator saw nothing beyond the sides of the tile cut out of the image,
+			// so cones are clamped to not reach past them, the image borders (without wrap) are real edges
+			const bool cut_left = wrap || x0 > 0;
+			const bool cut_right = wrap || x1 < width;
+			const bool cut_top = wrap || y0 > 0;
+			const bool cut_bottom = wrap || y1 < height;
+			const float texel_ratio = 1.0f / std::max(width, height); // one texel in the units of the cone ratios
+
+			// keep the inside of the tile
+			tile_row.resize(static_cast<size_t>(tile_width) * 4);
+			for (int y = y0; y < band_y + band_height; y++) {
+				if (!tile_reader.read_row(tile_row.data())) return fail();
+				if (y < band_y) continue;
+
+				for (int x = band_x; x < band_x + band_width; x++) {
+					const unsigned char *src = tile_row.data() + (x - x0) * 4;
+					unsigned char *dst = band_data + (static_cast<size_t>(y - band_y) * width + x) * 4;
+					long cone = std::min(255l, std::lround(src[1] * cone_scale));
+
+					// texels to the nearest cut side, at least the overlap
+					int margin = std::numeric_limits<int>::max();
+					if (cut_left) margin = std::min(margin, x - x0);
+					if (cut_right) margin = std::min(margin, x1 - 1 - x);
+					if (cut_top) margin = std::min(margin, y - y0);
+					if (cut_bottom) margin = std::min(margin, y1 - 1 - y);
+					// a cone spans 1 - height vertically above its texel
+					if (margin != std::numeric_limits<int>::max() && src[0] < 255) {
+						const float max_ratio = margin * texel_ratio / (1.0f - src[0] / 255.0f);
+						cone = std::min(cone, static_cast<long>(255.0f * std::sqrt(max_ratio)));
+					}
+
+					dst[0] = src[0];
+					dst[1] = static_cast<unsigned char>(cone);
+					dst[2] = src[2];
+					dst[3] = src[3];
+				}
+			}
+
+			std::filesystem::remove(tile_output, ec);
+
+			tiles_done++;
+			if (progress) progress(static_cast<float>(tiles_done) / (tiles_x * tiles_y));
+		}
+
+		// the band is complete
+		if (writer) {
+			if (!writer->write_rows(band_data, band_height)) return fail();
+		}
+	}
+
+	if (keep_in_memory) {
+		return GeneratedConeMap{output, width, height, image, false};
+	}
+
+	if (!writer || !writer->finish()) {
+		std::fprintf(stderr, "Error: Could not write %s.\n", output.c_str());
+		return fail();
+	}
+
+	return GeneratedConeMap{output, width, height, nullptr, true};
+}
@@ -0,0 +1,41 @@
+#ifndef TILED_GENERATION_HPP
+#define TILED_GENERATION_HPP
+
+// STD
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <stop_token>
+#include <vector>
+
+// a generated cone map
+struct GeneratedConeMap {
+	std::filesystem::path path; // empty on failure
+	int width = 0;
+	int height = 0;
+	std::shared_ptr<const std::vector<unsigned char>> pixels; // RGBA, null if the cone map is only on disk
+	bool written = true; // false while the pixels still have to be written to path
+};
+
+// largest cone map kept in memory instead of being streamed to disk
+inline constexpr size_t max_in_memory_cone_map_bytes = size_t(1) << 30;
+
+// Cone map generation of a height map in overlapping tiles.
+// Input rows are streamed from disk and output rows are written as soon as a band of tiles is done,
+// so only (tile_size + 2 * overlap) input rows and tile_size output rows are held in memory.
+// Inputs the streaming PNG reader does not support (JPEG, palette PNGs, ...) are decoded whole instead.
+// The overlap (at least 1) is how many texels around a tile the generator sees.
+// Cones are clamped so they do not reach past the sides of a tile cut out of the image,
+// so the output is conservative but cones are narrower than in a whole image map where the overlap is small.
+// A tile size of 0 processes the whole image as one tile.
+// With wrap, the overlap around the tiles is taken from the opposite edges of the image (toroidal lookups),
+// so the cone map is seamless when the texture is repeated.
+// Stopping is checked between tiles and progress is reported as the fraction of tiles done.
+// With in_memory, cone maps up to max_in_memory_cone_map_bytes are returned as pixels and not written,
+// writing them to the returned path is left to the caller.
+// The tiles themselves always go through PNG files, the generation library only works on paths.
+// Returns an empty path on failure or when stopped.
+GeneratedConeMap generate_tiled(const std::filesystem::path &output_directory, const std::filesystem::path &input, bool analytic, bool depthmap, int tile_size, int overlap, bool wrap = false,
+                                std::stop_token stop = {}, const std::function<void(float)> &progress = nullptr, bool in_memory = false);
+
+#endif